@@ -43,12 +43,53 @@
 __CONFIG(FOSC_INTOSC & WDTE_SWDTEN & PWRTE_ON & MCLRE_OFF & CP_ON & BOREN_ON & CLKOUTEN_OFF & IESO_OFF & FCMEN_OFF);
 __CONFIG(WRT_HALF & CPUDIV_NOCLKDIV & USBLSCLK_48MHz & PLLMULT_3x & PLLEN_ENABLED & STVREN_ON & BORV_LO & LPBOR_OFF & LVP_OFF);
 
+/*
+the interrupt vector is written here by hand rather than left to the compiler:
+it is shared with user code, so whose interrupt this is must be decided before anything else happens,
+and the code the compiler puts in front of an interrupt function may save its temporaries to RAM that,
+once user code runs, belongs to user code; the hardware has already saved W, STATUS, BSR, FSRs and PCLATH,
+and the user's RETFIE restores them, so the only things touched here are those
+user code lives from 0x1000 up, so if the return address on the stack is there, hand the interrupt on;
+the test skips a one-word relative branch, since a skip over LJMP would only skip its movlp
+the bootloader's own interrupt function is moved off the vector by the linker (-pintentry in the Makefile)
+*/
+#ifdef USB_USE_INTERRUPTS
+#asm
+	PSECT	bootloader_vector,class=CODE,delta=2,abs
+	ORG	0x0004
+	GLOBAL	__Lintentry
+	BANKSEL(_TOSH)
+	movlw	0x10
+	subwf	BANKMASK(_TOSH),w	/* carry (no borrow) if TOSH >= 0x10 */
+	btfsc	3,0			/* STATUS,C */
+	bra	user_interrupt
+	LJMP __Lintentry /* the bootloader's own interrupt */
+user_interrupt:
+	LJMP 0x1004 /* call user code interrupt vector */
+#endasm
+
 void interrupt ISRCode(void)
 {
+	usb_service();
+}
+#else
 #asm
-LJMP 0x1004 /* call user code interrupt vector */
+	PSECT	bootloader_vector,class=CODE,delta=2,abs
+	ORG	0x0004
+	LJMP 0x1004 /* call user code interrupt vector */
 #endasm
-}
+#endif
+
+/*
+the unlock sequence for a flash erase or write must not be interrupted
+*/
+#ifdef USB_USE_INTERRUPTS
+#define UNLOCK_BEGIN() INTCONbits.GIE = 0
+#define UNLOCK_END()   INTCONbits.GIE = 1
+#else
+#define UNLOCK_BEGIN()
+#define UNLOCK_END()
+#endif
 
 /* bit field definitions for "flags" variable in main() */
 #define FLAG_USERCODE        0x01
@@ -64,6 +105,7 @@ int main(void)
 	uint8_t *TxDataBuffer;
 	const uint8_t *RxDataBuffer;
 	uint8_t len;
+	uint8_t command[32 + 3];
 
 	/* enable pull-up on RA3 (for boot mode detection) */
 	OPTION_REGbits.nWPUEN = 0;
@@ -180,11 +222,18 @@ int main(void)
 
 	usb_init();
 
+#ifdef USB_USE_INTERRUPTS
+	INTCONbits.PEIE = 1;
+	INTCONbits.GIE = 1;
+#endif
+
 	TxDataBuffer = usb_get_in_buffer(1);
 
 	for (;;)
 	{
+#ifndef USB_USE_INTERRUPTS
 		usb_service();
+#endif
 
 		/* if USB isn't configured, there is no point in proceeding further */
 		if (!usb_is_configured())
@@ -204,6 +253,14 @@ int main(void)
 		/* obtain a pointer to the receive buffer and the length of data contained within it */
 		len = usb_get_out_buffer(1, &RxDataBuffer);
 
+		/*
+		take a copy of the command and re-arm the endpoint straight away, so that the host's next command
+		can arrive (and wait in the endpoint buffer) while this one is carried out
+		*/
+		memcpy(command, RxDataBuffer, sizeof(command));
+		RxDataBuffer = command;
+		usb_arm_out_endpoint(1);
+
 		/*
 		if tx_count is set to be non-zero by subsequent code, this indicates data
 		of length tx_count is in DataBuffer[] to be passed to the USB driver
@@ -256,12 +313,17 @@ int main(void)
 			PMCON1bits.FREE = 1;
 			/* enable write/erase operation */
 			PMCON1bits.WREN = 1;
+			/* the reply is only an echo, so it goes before the CPU stalls for the erase */
+			usb_send_in_buffer(1, EP_1_IN_LEN);
+			tx_count = 0;
 			/* unlock sequence */
+			UNLOCK_BEGIN();
 			PMCON2 = 0x55;
 			PMCON2 = 0xAA;
 			PMCON1bits.WR = 1;
 			/* mandatory two nops */
 			_nop(); _nop();
+			UNLOCK_END();
 			/* disable write/erase operation */
 			PMCON1bits.WREN = 0;
 			break;
@@ -277,6 +339,9 @@ int main(void)
 			PMCON1bits.LWLO = 1;
 			/* enable write/erase operation */
 			PMCON1bits.WREN = 1;
+			/* the reply is only an echo, so it goes before the CPU stalls for the write */
+			usb_send_in_buffer(1, EP_1_IN_LEN);
+			tx_count = 0;
 
 			index = 3;
 
@@ -290,11 +355,13 @@ int main(void)
 					PMCON1bits.LWLO = 0;
 				}
 				/* unlock sequence */
+				UNLOCK_BEGIN();
 				PMCON2 = 0x55;
 				PMCON2 = 0xAA;
 				PMCON1bits.WR = 1;
 				/* mandatory two nops */
 				_nop(); _nop();
+				UNLOCK_END();
 				if ( (index >= (32 + 3)) || PMCON1bits.CFGS )
 				{
 					/* we've finished, so bail */
@@ -309,11 +376,32 @@ int main(void)
 			/* disable write/erase operation */
 			PMCON1bits.WREN = 0;
 			break;
-		}
 
-		usb_send_in_buffer(1, EP_1_IN_LEN);
+		case 0x88:  /* Reset to user code */
+			/* answer, and give the host time to collect the answer */
+			usb_send_in_buffer(1, EP_1_IN_LEN);
+			tx_count = 0;
+			for (data = 0; (data < 0xFFFF) && usb_in_endpoint_busy(1); data++)
+			{
+#ifndef USB_USE_INTERRUPTS
+				usb_service();
+#endif
+			}
+			/* drop off the bus for long enough (around 100ms) for the host to notice the device has gone */
+			INTCONbits.GIE = 0;
+			UCONbits.USBEN = 0;
+			for (index = 0; index < 25; index++)
+				_delay(48000);
+			/*
+			CLRWDT sets /TO, so the reset isn't taken for the watchdog timeout that the example apps use
+			to get back here; the boot path then starts user code, provided its CRC passes and RA3 isn't held low
+			*/
+			CLRWDT();
+			RESET();
+			break;
+		}
 
-		/* re-arm the endpoint to receive the next EP1 OUT */
-		usb_arm_out_endpoint(1);
+		if (tx_count)
+			usb_send_in_buffer(1, EP_1_IN_LEN);
 	}
 }
@@ -47,6 +47,15 @@
 
 #define PPB_MODE PPB_NONE /* Do not ping-pong any endpoints */
 
+/* Uncomment to service USB from the interrupt instead of the command loop, so that control
+   transfers are answered between the steps of a flash erase or write.  The bootloader's ISR
+   hands every interrupt to the user code's vector once that is running. */
+//#define USB_USE_INTERRUPTS
+
+/* Handle up to this many completed transactions per usb_service() call
+   instead of one; the USTAT FIFO holds four. */
+//#define USB_MAX_TOKENS_PER_SERVICE 4
+
 /* Objects from usb_descriptors.c */
 #define USB_DEVICE_DESCRIPTOR this_device_descriptor
 #define USB_CONFIG_DESCRIPTOR_MAP usb_application_config_descs
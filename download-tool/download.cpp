@@ -31,28 +31,73 @@ http://www.signal11.us/oss/hidapi/
 
 #include <FL/Fl.H>
 #include <FL/Fl_Button.H>
+#include <FL/Fl_Light_Button.H>
 #include <FL/Fl_File_Chooser.H>
 #include <FL/Fl_Progress.H>
 #include "hidapi.h"
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
 
 #define MARGIN_SIZE    12
 #define BUTTON_HEIGHT  32
 #define BUTTON_WIDTH   96
 #define PROGRESS_WIDTH 128
-#define WINDOW_HEIGHT  (2 * BUTTON_HEIGHT + 3 * MARGIN_SIZE)
+#ifdef WIN32
+#define BUTTON_COUNT   2
+#else
+#define BUTTON_COUNT   3 /* "Auto" relies on the hotplug support in hid-libusb.c */
+#endif
+#define WINDOW_HEIGHT  (BUTTON_COUNT * BUTTON_HEIGHT + (BUTTON_COUNT + 1) * MARGIN_SIZE)
 #define WINDOW_WIDTH  ((BUTTON_WIDTH + PROGRESS_WIDTH) + 3 * MARGIN_SIZE)
 
 #define HID_BUFFER_SIZE 65
 
+#define HOTPLUG_POLL_INTERVAL 0.02 /* seconds */
+#define OPEN_ATTEMPTS         50   /* one per HOTPLUG_POLL_INTERVAL, so about a second */
+#define MAX_PENDING           16   /* attached devices that can be waiting to be opened at once */
+
+#define BOOTLOADER_VID 0x1D50
+#define BOOTLOADER_PID 0x609D
+
+/*
+one-byte Feature report value that the example apps take as a request to reboot into the bootloader;
+it goes to their collection on the vendor page (see reboot_request.h in the apps)
+*/
+#define REBOOT_REQUEST    0xB0
+#define REBOOT_USAGE_PAGE 0xFF00
+
+/* how long a device is given to drop off the bus and come back as something else */
+#define REENUMERATE_TIMEOUT 5000 /* milliseconds */
+#define REENUMERATE_POLL    100  /* milliseconds */
+
 static void hex_button_cb(Fl_Widget *p, void *data);
 static void flash_button_cb(Fl_Widget *p, void *data);
+#ifndef WIN32
+static void auto_button_cb(Fl_Widget *p, void *data);
+static void hotplug_timer_cb(void *data);
+static void arrival_cb(const char *path, void *user_data);
+static void open_pending(void);
+#endif
 
 static unsigned readhex(const char *text, unsigned digits);
+static const char *program_device(hid_device *handle);
 static int xfer(hid_device *handle, unsigned char *data, int txlen);
+static bool reboot_app(void);
+static hid_device *wait_for_bootloader(void);
+static bool wait_for_app(void);
+static void sleep_ms(unsigned ms);
 
 static Fl_Window *win;
 static Fl_Progress *progress;
 static Fl_Button *hex_button, *flash_button;
+#ifndef WIN32
+static Fl_Light_Button *auto_button;
+static unsigned boards_programmed, boards_failed;
+#endif
 static Fl_File_Chooser *fc;
 
 static unsigned char image[8192];
@@ -75,7 +120,13 @@ int main (int argc, char *argv[])
 	flash_button->callback(flash_button_cb, NULL);
 	flash_button->deactivate();
 
-	progress = new Fl_Progress(MARGIN_SIZE, MARGIN_SIZE, PROGRESS_WIDTH, 2 * BUTTON_HEIGHT + MARGIN_SIZE);
+#ifndef WIN32
+	auto_button = new Fl_Light_Button(PROGRESS_WIDTH + 2 * MARGIN_SIZE, 2 * BUTTON_HEIGHT + 3 * MARGIN_SIZE, BUTTON_WIDTH, BUTTON_HEIGHT, "Auto");
+	auto_button->callback(auto_button_cb, NULL);
+	auto_button->deactivate();
+#endif
+
+	progress = new Fl_Progress(MARGIN_SIZE, MARGIN_SIZE, PROGRESS_WIDTH, BUTTON_COUNT * BUTTON_HEIGHT + (BUTTON_COUNT - 1) * MARGIN_SIZE);
 	progress->deactivate();
  
 	fc = new Fl_File_Chooser(".", "Intel Hex files (*.{hex})", Fl_File_Chooser::SINGLE, "pick PIC16F1454 firmware file");
@@ -104,6 +155,9 @@ static void hex_button_cb(Fl_Widget *p, void *data)
 	unsigned local_address, max_address, crc_address;
 
 	flash_button->deactivate();
+#ifndef WIN32
+	auto_button->deactivate();
+#endif
 
 	memset(&flags, 0, sizeof(flags));
 
@@ -203,6 +257,9 @@ static void hex_button_cb(Fl_Widget *p, void *data)
 	image[crc_address + 0] = (unsigned char)((crc & 0x00FF) >> 0);
 
 	flash_button->activate();
+#ifndef WIN32
+	auto_button->activate();
+#endif
 }
 
 static unsigned readhex(const char *text, unsigned digits)
@@ -238,13 +295,26 @@ static const unsigned valid_device_ids[] =
 	0x3027, /* PIC16LF1459 */
 };
 
+/*
+IMPORTANT!
+add the VID:PID of your application; those listed here answer the reboot request,
+so that the tool can get them into the bootloader and see them come back afterwards
+the third number is the interface that takes the request (REBOOT_INTERFACE in the app, if it has one)
+*/
+
+static const unsigned short app_ids[][3] =
+{
+	{ 0x04D8, 0x003F, 0 }, /* customHID */
+	{ 0x04D8, 0x0055, 1 }, /* passfob */
+	{ 0x04D8, 0x0000, 1 }, /* mouseplay */
+	{ 0xA0A0, 0x0003, 1 }, /* hid_mouse */
+};
+
 static void flash_button_cb(Fl_Widget *p, void *data)
 {
-	unsigned char buf[HID_BUFFER_SIZE];
 	hid_device *handle;
-	unsigned index, address, count;
-	int res = 0;
-	const char *caption = NULL;
+	const char *caption;
+	unsigned char buf[HID_BUFFER_SIZE];
 
 	if (hid_init() != 0)
 	{
@@ -252,17 +322,298 @@ static void flash_button_cb(Fl_Widget *p, void *data)
 		return;
 	}
 
-	/*
-	IMPORTANT!
-	replace with VID:PID of your application
-	*/
-	handle = hid_open(0x1D50, 0x609D, NULL);
+	handle = hid_open(BOOTLOADER_VID, BOOTLOADER_PID, NULL);
+
+	/* if there is no bootloader, ask a running app to reboot into it */
+	if (!handle && reboot_app())
+		handle = wait_for_bootloader();
 
 	if (!handle)
 	{
 		caption = "a USB device with the bootloader's VID:PID was not to be found";
-		goto bail; 
 	}
+	else
+	{
+		caption = program_device(handle);
+
+		if (!caption)
+		{
+			buf[0] = 0x00;
+			buf[1] = 0x88; /* reset to user code */
+			buf[2] = 0x00;
+			buf[3] = 0x00;
+
+			if (-1 == xfer(handle, buf, HID_BUFFER_SIZE))
+				caption = "programming was successful!\ndisconnect and reconnect device to boot new code";
+		}
+
+		hid_close(handle);
+	}
+
+	if (!caption)
+	{
+		if (wait_for_app())
+			caption = "programming was successful!\nthe device has been reset and is running the new code";
+		else
+			caption = "programming was successful!\nthe device has been reset, but has not come back as a known application";
+	}
+
+	fl_alert("%s", caption);
+
+	hid_exit();
+}
+
+/* send the reboot request to the first known app found; returns true if one took it */
+static bool reboot_app(void)
+{
+	struct hid_device_info *devs, *cur;
+	hid_device *handle;
+	unsigned char buf[2];
+	unsigned index;
+	int res = -1;
+
+	for (index = 0; index < (sizeof(app_ids) / sizeof(*app_ids)); index++)
+	{
+		devs = hid_enumerate(app_ids[index][0], app_ids[index][1]);
+
+		/*
+		a keyboard or mouse has the request on an interface of its own, as the host won't share the first one;
+		some HIDAPI backends give the usage page of each collection, the libusb one only the interface number
+		*/
+		for (cur = devs; cur && (-1 == res); cur = cur->next)
+		{
+			if (cur->usage_page ? (REBOOT_USAGE_PAGE != cur->usage_page) : (app_ids[index][2] != cur->interface_number))
+				continue;
+
+			handle = hid_open_path(cur->path);
+			if (!handle)
+				continue;
+
+			buf[0] = 0x00; /* no report ID */
+			buf[1] = REBOOT_REQUEST;
+
+			res = hid_send_feature_report(handle, buf, sizeof(buf));
+
+			hid_close(handle);
+		}
+
+		hid_free_enumeration(devs);
+
+		if (-1 != res)
+			return true;
+	}
+
+	return false;
+}
+
+static hid_device *wait_for_bootloader(void)
+{
+	hid_device *handle;
+	unsigned waited;
+
+	for (waited = 0; waited < REENUMERATE_TIMEOUT; waited += REENUMERATE_POLL)
+	{
+		sleep_ms(REENUMERATE_POLL);
+
+		handle = hid_open(BOOTLOADER_VID, BOOTLOADER_PID, NULL);
+		if (handle)
+			return handle;
+	}
+
+	return NULL;
+}
+
+/* wait for any known app to appear (the bootloader has a VID:PID of its own, so this can only be the new code) */
+static bool wait_for_app(void)
+{
+	hid_device *handle;
+	unsigned waited, index;
+
+	for (waited = 0; waited < REENUMERATE_TIMEOUT; waited += REENUMERATE_POLL)
+	{
+		sleep_ms(REENUMERATE_POLL);
+
+		for (index = 0; index < (sizeof(app_ids) / sizeof(*app_ids)); index++)
+		{
+			handle = hid_open(app_ids[index][0], app_ids[index][1], NULL);
+			if (handle)
+			{
+				hid_close(handle);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static void sleep_ms(unsigned ms)
+{
+#ifdef WIN32
+	Sleep(ms);
+#else
+	usleep(ms * 1000);
+#endif
+}
+
+#ifndef WIN32
+
+/*
+in Auto mode, each bootloader is programmed with the loaded image as soon as it is attached;
+the outcome and timing of every board is written to stdout and summarized in the window title
+
+boards are left in the bootloader rather than reset into the new code: a board held in the bootloader
+(by RA3) would only come straight back and be programmed again and again
+*/
+
+/*
+udev may still be setting the permissions of a device which has only just arrived, so one that can't be opened yet
+is kept here and tried again on each timer tick, rather than holding up the GUI waiting for it
+*/
+
+static struct
+{
+	char *path;
+	struct timespec arrived;
+	unsigned attempts;
+} pending[MAX_PENDING];
+
+static unsigned pending_count;
+
+static void auto_button_cb(Fl_Widget *p, void *data)
+{
+	if (auto_button->value())
+	{
+		if ( (hid_init() != 0) || (hid_hotplug_register(BOOTLOADER_VID, BOOTLOADER_PID, arrival_cb, NULL) != 0) )
+		{
+			fl_alert("unable to watch for USB devices being attached");
+			auto_button->value(0);
+			hid_exit();
+			return;
+		}
+
+		hex_button->deactivate();
+		flash_button->deactivate();
+
+		boards_programmed = boards_failed = 0;
+		win->label("Firmware Update (waiting)");
+
+		Fl::add_timeout(HOTPLUG_POLL_INTERVAL, hotplug_timer_cb);
+	}
+	else
+	{
+		Fl::remove_timeout(hotplug_timer_cb);
+
+		while (pending_count)
+			free(pending[--pending_count].path);
+
+		hid_hotplug_deregister();
+		hid_exit();
+
+		win->label("Firmware Update");
+
+		hex_button->activate();
+		flash_button->activate();
+	}
+}
+
+static void hotplug_timer_cb(void *data)
+{
+	hid_hotplug_poll(0);
+
+	open_pending();
+
+	Fl::repeat_timeout(HOTPLUG_POLL_INTERVAL, hotplug_timer_cb);
+}
+
+static unsigned long elapsed_ms(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1000L + (end->tv_nsec - start->tv_nsec) / 1000000L;
+}
+
+static void report_board(const char *path, const struct timespec *arrived, const struct timespec *opened, const char *caption)
+{
+	struct timespec done;
+	char title[96];
+
+	clock_gettime(CLOCK_MONOTONIC, &done);
+
+	if (caption)
+		boards_failed++;
+	else
+		boards_programmed++;
+
+	printf("%s: %s (open %lu ms, total %lu ms)\n", path, caption ? caption : "programmed", elapsed_ms(arrived, opened), elapsed_ms(arrived, &done));
+	fflush(stdout);
+
+	snprintf(title, sizeof(title), "%u programmed, %u failed, last %lu ms", boards_programmed, boards_failed, elapsed_ms(arrived, &done));
+	win->copy_label(title);
+}
+
+static void arrival_cb(const char *path, void *user_data)
+{
+	struct timespec arrived;
+
+	clock_gettime(CLOCK_MONOTONIC, &arrived);
+
+	if ( (MAX_PENDING == pending_count) || !(pending[pending_count].path = strdup(path)) )
+	{
+		report_board(path, &arrived, &arrived, "too many devices waiting to be opened");
+		return;
+	}
+
+	pending[pending_count].arrived = arrived;
+	pending[pending_count].attempts = 0;
+	pending_count++;
+
+	/* most of the time, the device can be opened straight away */
+	open_pending();
+}
+
+static void open_pending(void)
+{
+	struct timespec opened;
+	hid_device *handle;
+	const char *caption;
+	unsigned index;
+
+	for (index = 0; index < pending_count; )
+	{
+		handle = hid_open_path(pending[index].path);
+
+		if (!handle && (++pending[index].attempts < OPEN_ATTEMPTS))
+		{
+			index++;
+			continue;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &opened);
+
+		if (!handle)
+		{
+			caption = "unable to open device";
+		}
+		else
+		{
+			caption = program_device(handle);
+			hid_close(handle);
+		}
+
+		report_board(pending[index].path, &pending[index].arrived, &opened, caption);
+
+		free(pending[index].path);
+		pending[index] = pending[--pending_count];
+	}
+}
+
+#endif
+
+/* erase and program the user area; returns NULL on success, otherwise a description of the failure */
+static const char *program_device(hid_device *handle)
+{
+	unsigned char buf[HID_BUFFER_SIZE];
+	unsigned index, address, count;
+	int res = 0;
 
 	buf[0] = 0x00;
 	buf[1] = 0x84; /* read config */
@@ -273,8 +624,7 @@ static void flash_button_cb(Fl_Widget *p, void *data)
 
 	if (-1 == res)
 	{
-		caption = "unable to read PIC's Device ID";
-		goto bail;
+		return "unable to read PIC's Device ID";
 	}
 
 	/* extract the Device ID */
@@ -290,8 +640,7 @@ static void flash_button_cb(Fl_Widget *p, void *data)
 	}
 
 	/* if execution has reached here, the Device ID did not match a valid value */
-	caption = "the PIC's Device ID is invalid";
-	goto bail;
+	return "the PIC's Device ID is invalid";
 
 device_id_is_valid:
 
@@ -308,8 +657,7 @@ device_id_is_valid:
 
 		if (-1 == res)
 		{
-			caption = "failure whilst attempting erase";
-			goto bail;
+			return "failure whilst attempting erase";
 		}
 
 		buf[0] = 0x00;
@@ -321,14 +669,12 @@ device_id_is_valid:
 
 		if (-1 == res)
 		{
-			caption = "failure whilst attempting erase verify";
-			goto bail;
+			return "failure whilst attempting erase verify";
 		}
 
 		if (memcmp(buf + 3, erased_state, sizeof(erased_state)))
 		{
-			caption = "part did not erase properly";
-			goto bail;
+			return "part did not erase properly";
 		}
 
 		buf[0] = 0x00;
@@ -347,8 +693,7 @@ device_id_is_valid:
 
 		if (-1 == res)
 		{
-			caption = "failure whilst attempting programming lower half";
-			goto bail;
+			return "failure whilst attempting programming lower half";
 		}
 
 		index += 16;
@@ -369,19 +714,11 @@ device_id_is_valid:
 
 		if (-1 == res)
 		{
-			caption = "failure whilst attempting programming upper half";
-			goto bail;
+			return "failure whilst attempting programming upper half";
 		}
 	}
 
-	caption = "programming was successful!\ndisconnect and reconnect device to boot new code";
-
-bail:
-	if (caption)
-		fl_alert("%s", caption);
-
-	hid_close(handle);
-	hid_exit();
+	return NULL;
 }
 
 /* Send a message and receive the reply */
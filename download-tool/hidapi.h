@@ -78,6 +78,53 @@ extern "C" {
 			struct hid_device_info *next;
 		};
 
+		/** Minimum, maximum and total of a set of intervals */
+		struct hid_latency {
+			/** Number of intervals recorded */
+			unsigned long count;
+			/** Shortest interval, in microseconds */
+			unsigned long min_us;
+			/** Longest interval, in microseconds */
+			unsigned long max_us;
+			/** Sum of all intervals, in microseconds */
+			unsigned long long total_us;
+		};
+
+		/** Input report statistics of an open device */
+		struct hid_stats {
+			/** Input reports received from the device */
+			unsigned long reports;
+			/** Reports discarded because the application
+			    didn't read them quickly enough */
+			unsigned long drops;
+			/** Transfers resubmitted to the device */
+			unsigned long resubmits;
+			/** Transfers which timed out without data */
+			unsigned long transfer_timeouts;
+			/** Transfers which failed */
+			unsigned long transfer_errors;
+			/** Timed reads which returned without a report */
+			unsigned long read_timeouts;
+			/** Reports currently queued */
+			unsigned queue_length;
+			/** Most reports which have been queued at once */
+			unsigned queue_high_water;
+			/** From submission of a transfer to it becoming the
+			    oldest one in flight (time spent queued behind
+			    the transfers submitted before it) */
+			struct hid_latency submit_to_head;
+			/** From a transfer becoming the oldest one in flight
+			    to its completion (time spent waiting on the
+			    device and the bus) */
+			struct hid_latency head_to_complete;
+			/** From completion to the report being queued
+			    (time spent in the read callback) */
+			struct hid_latency complete_to_enqueue;
+			/** From being queued to being read by the
+			    application */
+			struct hid_latency enqueue_to_dequeue;
+		};
+
 
 		/** @brief Initialize the HIDAPI library.
 
@@ -129,6 +176,51 @@ extern "C" {
 		*/
 		struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned short vendor_id, unsigned short product_id);
 
+		/** Flag for hid_enumerate_ex(): don't open the devices to read
+		    their serial number, manufacturer and product strings. */
+		#define HID_ENUM_SKIP_STRINGS 0x01
+
+		/** @brief Enumerate the HID Devices, with options.
+
+			This function is the same as hid_enumerate(), except that
+			@p flags selects which parts of the enumeration are done.
+			Devices which don't match @p vendor_id and @p product_id are
+			rejected before any of their descriptors other than the
+			device descriptor are read.
+
+			With #HID_ENUM_SKIP_STRINGS, no device is opened and the
+			string fields of the returned records are NULL. They can be
+			filled in later, for only the records which need them, with
+			hid_get_info_strings().
+
+			@ingroup API
+			@param vendor_id The Vendor ID (VID) of the types of device
+				to open.
+			@param product_id The Product ID (PID) of the types of
+				device to open.
+			@param flags Zero or more HID_ENUM_* flags.
+
+		    @returns
+		    	This function returns a pointer to a linked list of type
+		    	struct #hid_device, or NULL in the case of failure. Free
+		    	this linked list by calling hid_free_enumeration().
+		*/
+		struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate_ex(unsigned short vendor_id, unsigned short product_id, int flags);
+
+		/** @brief Fill in the strings of an enumeration record.
+
+			This function reads the serial number, manufacturer and
+			product strings which are missing from a record returned by
+			hid_enumerate_ex() with #HID_ENUM_SKIP_STRINGS.
+
+			@ingroup API
+			@param info A record from hid_enumerate_ex().
+
+			@returns
+				This function returns 0 on success and -1 on error.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_get_info_strings(struct hid_device_info *info);
+
 		/** @brief Free an enumeration Linked List
 
 		    This function frees a linked list created by hid_enumerate().
@@ -161,7 +253,9 @@ extern "C" {
 
 			The path name be determined by calling hid_enumerate(), or a
 			platform-specific path name can be used (eg: /dev/hidraw0 on
-			Linux).
+			Linux). On the libusb implementation, only the device named
+			by the path is examined, so a path kept from an earlier
+			hid_enumerate_ex() can be reopened cheaply.
 
 			@ingroup API
 		    @param path The path name of the device to open
@@ -239,6 +333,96 @@ extern "C" {
 		*/
 		int  HID_API_EXPORT HID_API_CALL hid_read(hid_device *device, unsigned char *data, size_t length);
 
+		/** @brief Read several Input reports from a HID device at once.
+
+			This function waits, as hid_read_timeout() does, until at
+			least one report is available. It then returns that report
+			and any others already queued, up to @p max_reports, while
+			taking the device's queue lock only once. Report @p n is
+			stored at @p data + @p n * @p report_size, and its length in
+			@p lengths[n].
+
+			@ingroup API
+			@param device A device handle returned from hid_open().
+			@param data A buffer of @p max_reports * @p report_size
+				bytes to put the reports into.
+			@param report_size The space for each report in @p data.
+				Longer reports are truncated.
+			@param lengths An array of @p max_reports lengths, one per
+				report read.
+			@param max_reports The most reports to return.
+			@param milliseconds timeout in milliseconds or -1 for blocking wait.
+
+			@returns
+				This function returns the number of reports read, which
+				is 0 if the timeout expired, or -1 on error (including
+				a max_reports of 0 or less).
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_read_many(hid_device *device, unsigned char *data, size_t report_size, size_t *lengths, int max_reports, int milliseconds);
+
+		/** @brief Borrow the next Input report without copying it.
+
+			This function waits, as hid_read_timeout() does, for an
+			Input report and then lends the caller the buffer that the
+			report was received into. The buffer is not reused until it
+			is handed back with hid_read_release(), so it must be
+			released promptly; reports which arrive while all buffers
+			are lent out are held off at the device. Every borrowed
+			buffer must be released before hid_close().
+
+			@ingroup API
+			@param device A device handle returned from hid_open().
+			@param data Set to the report data, or NULL if no report
+				is returned.
+			@param milliseconds timeout in milliseconds or -1 for blocking wait.
+
+			@returns
+				This function returns the length of the borrowed report,
+				0 if no report was available within the timeout, or -1 on
+				error.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_read_borrow(hid_device *device, const unsigned char **data, int milliseconds);
+
+		/** @brief Give back a buffer from hid_read_borrow().
+
+			@ingroup API
+			@param device A device handle returned from hid_open().
+			@param data The pointer returned by hid_read_borrow().
+
+			@returns
+				This function returns 0 on success and -1 if data is not
+				a buffer that is currently lent out, for example one that
+				has already been released.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_read_release(hid_device *device, const unsigned char *data);
+
+		/** @brief Get the Input report statistics of a HID device.
+
+			The counters are always kept. The latency fields are only
+			filled in by a HIDAPI built with REPORT_LATENCY_TRACE;
+			otherwise they are zero.
+
+			@ingroup API
+			@param device A device handle returned from hid_open().
+			@param stats Filled in with the statistics so far.
+
+			@returns
+				This function returns 1 if latencies are being traced,
+				0 if they are not, and -1 on error.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_get_stats(hid_device *device, struct hid_stats *stats);
+
+		/** @brief Print the Input report statistics of a HID device.
+
+			This function writes the statistics of hid_get_stats() to
+			stderr, followed by the timestamps of the most recent
+			reports if latencies are being traced.
+
+			@ingroup API
+			@param device A device handle returned from hid_open().
+		*/
+		void HID_API_EXPORT HID_API_CALL hid_dump_stats(hid_device *device);
+
 		/** @brief Set the device handle to be non-blocking.
 
 			In non-blocking mode calls to hid_read() will return
@@ -375,6 +559,56 @@ extern "C" {
 		*/
 		HID_API_EXPORT const wchar_t* HID_API_CALL hid_error(hid_device *device);
 
+		/** Type of the function called by hid_hotplug_poll() for each
+		    device arrival. @p path can be passed to hid_open_path(). */
+		typedef void (HID_API_CALL *hid_hotplug_callback)(const char *path, void *user_data);
+
+		/** @brief Watch for HID devices being attached.
+
+			This function arranges for @p callback to be called with the
+			path of each matching HID device which is attached from now
+			on. Devices which are already attached are reported as well.
+			If @p vendor_id and @p product_id are both set to 0, then
+			all HID devices will be reported. Only one registration can
+			be active at a time.
+
+			Arrivals are only delivered from within hid_hotplug_poll(),
+			which must be called regularly.
+
+			@ingroup API
+			@param vendor_id The Vendor ID (VID) of the devices to watch.
+			@param product_id The Product ID (PID) of the devices to watch.
+			@param callback The function to call on each arrival.
+			@param user_data Passed unchanged to @p callback.
+
+			@returns
+				This function returns 0 on success and -1 on error,
+				including when the platform has no hotplug support.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_hotplug_register(unsigned short vendor_id, unsigned short product_id, hid_hotplug_callback callback, void *user_data);
+
+		/** @brief Deliver pending device arrivals.
+
+			This function waits up to @p milliseconds for hotplug events
+			and then calls the registered callback, on the calling thread,
+			for each device which has arrived.
+
+			@ingroup API
+			@param milliseconds The longest time to wait for events, or 0
+				to only deliver what is already pending.
+
+			@returns
+				This function returns the number of arrivals delivered and
+				-1 on error.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_hotplug_poll(int milliseconds);
+
+		/** @brief Stop watching for HID devices being attached.
+
+			@ingroup API
+		*/
+		void HID_API_EXPORT HID_API_CALL hid_hotplug_deregister(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -66,13 +66,52 @@ Linux/libusb HIDAPI programs are encouraged to use the interface number
 instead to differentiate between interfaces on a composite HID device. */
 /*#define INVASIVE_GET_USAGE*/
 
-/* Linked List of input reports received from the device. */
+/* Uncomment to timestamp every input report (CLOCK_MONOTONIC) when its
+transfer is submitted, when it becomes the oldest transfer in flight, when
+it completes, when it is queued and when the application collects it. With
+NUM_READ_TRANSFERS submitted at once, a transfer mostly waits behind the
+ones submitted before it, and the bus only starts on it once the one ahead
+has completed; that wait is kept apart from the time spent on the device
+and the bus. The intervals are summarized in the latency fields of struct
+hid_stats, and the last TRACE_DEPTH reports are printed by
+hid_dump_stats(). The counters in struct hid_stats are kept regardless. */
+/*#define REPORT_LATENCY_TRACE*/
+#define TRACE_DEPTH 64
+
+/* Number of interrupt IN transfers kept for each device. Completed
+   transfers are queued as input reports and only resubmitted once the
+   report has been read, so this also bounds the queue length. */
+#define NUM_READ_TRANSFERS 32
+
+/* Linked List of input reports received from the device. Each report
+   lives in the buffer of the transfer which received it; there is one
+   of these for every transfer. */
 struct input_report {
 	uint8_t *data;
 	size_t len;
 	struct input_report *next;
+	struct libusb_transfer *transfer;
+	struct hid_device_ *dev;
+	int lent; /* handed out by hid_read_borrow(); protected by mutex */
+#ifdef REPORT_LATENCY_TRACE
+	struct timespec submitted;
+	struct timespec head; /* became the oldest transfer in flight */
+	struct timespec completed;
+	struct timespec enqueued;
+#endif
 };
 
+#ifdef REPORT_LATENCY_TRACE
+/* The timestamps of one report, from submission to collection. */
+struct trace_entry {
+	struct timespec submitted;
+	struct timespec head;
+	struct timespec completed;
+	struct timespec enqueued;
+	struct timespec dequeued;
+};
+#endif
+
 
 struct hid_device_ {
 	/* Handle to the actual device. */
@@ -100,19 +139,32 @@ struct hid_device_ {
 	pthread_cond_t condition;
 	pthread_barrier_t barrier; /* Ensures correct startup sequence */
 	int shutdown_thread;
-	struct libusb_transfer *transfer;
+	struct input_report *read_slots; /* NUM_READ_TRANSFERS of them */
+	int transfers_in_flight; /* Protected by mutex */
 
 	/* List of received input reports. */
 	struct input_report *input_reports;
+
+	/* Counters, and latencies if enabled. Protected by mutex. */
+	struct hid_stats stats;
+#ifdef REPORT_LATENCY_TRACE
+	struct trace_entry trace[TRACE_DEPTH];
+	unsigned trace_next;
+	struct timespec last_completed; /* of the previous transfer */
+#endif
 };
 
 static int initialized = 0;
 
 uint16_t get_usb_code_for_current_locale(void);
 static int return_data(hid_device *dev, unsigned char *data, size_t length);
+static int open_interface(hid_device *dev, libusb_device *usb_dev,
+                          const struct libusb_device_descriptor *desc,
+                          const struct libusb_interface_descriptor *intf_desc);
 
 static hid_device *new_hid_device(void)
 {
+	pthread_condattr_t condattr;
 	hid_device *dev = calloc(1, sizeof(hid_device));
 	dev->device_handle = NULL;
 	dev->input_endpoint = 0;
@@ -124,12 +176,19 @@ static hid_device *new_hid_device(void)
 	dev->serial_index = 0;
 	dev->blocking = 1;
 	dev->shutdown_thread = 0;
-	dev->transfer = NULL;
+	dev->read_slots = NULL;
+	dev->transfers_in_flight = 0;
 	dev->input_reports = NULL;
 	
 	pthread_mutex_init(&dev->mutex, NULL);
-	pthread_cond_init(&dev->condition, NULL);
 	pthread_barrier_init(&dev->barrier, NULL, 2);
+
+	/* Timed reads wait on the condition against CLOCK_MONOTONIC so that
+	   their deadline isn't moved by changes to the wall clock. */
+	pthread_condattr_init(&condattr);
+	pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&dev->condition, &condattr);
+	pthread_condattr_destroy(&condattr);
 	
 	return dev;
 }
@@ -381,6 +440,87 @@ static char *make_path(libusb_device *dev, int interface_number)
 	return strdup(str);
 }
 
+/* Splits a path created by make_path() back into its bus number, device
+   address and interface number. Returns 0 on success and -1 if the path
+   is not one of ours. */
+static int parse_path(const char *path, int *bus, int *address, int *interface_number)
+{
+	if (sscanf(path, "%x:%x:%x", bus, address, interface_number) != 3)
+		return -1;
+
+	return 0;
+}
+
+/* Retrieves whichever of the serial number, manufacturer and product
+   strings of an enumeration record are not already filled in. */
+static void fill_info_strings(libusb_device_handle *handle,
+                              const struct libusb_device_descriptor *desc,
+                              struct hid_device_info *info)
+{
+	/* Serial Number */
+	if (!info->serial_number && desc->iSerialNumber > 0)
+		info->serial_number =
+			get_usb_string(handle, desc->iSerialNumber);
+
+	/* Manufacturer and Product strings */
+	if (!info->manufacturer_string && desc->iManufacturer > 0)
+		info->manufacturer_string =
+			get_usb_string(handle, desc->iManufacturer);
+	if (!info->product_string && desc->iProduct > 0)
+		info->product_string =
+			get_usb_string(handle, desc->iProduct);
+}
+
+/* Returns the first HID interface in a configuration descriptor, or NULL
+   if there is none. If interface_number is not negative, only that
+   interface is considered. */
+static const struct libusb_interface_descriptor *find_hid_interface(
+	const struct libusb_config_descriptor *conf_desc, int interface_number)
+{
+	int j, k;
+
+	for (j = 0; j < conf_desc->bNumInterfaces; j++) {
+		const struct libusb_interface *intf = &conf_desc->interface[j];
+		for (k = 0; k < intf->num_altsetting; k++) {
+			const struct libusb_interface_descriptor *intf_desc;
+			intf_desc = &intf->altsetting[k];
+			if (intf_desc->bInterfaceClass != LIBUSB_CLASS_HID)
+				continue;
+			if (interface_number < 0 ||
+			    intf_desc->bInterfaceNumber == interface_number)
+				return intf_desc;
+		}
+	}
+
+	return NULL;
+}
+
+/* Returns non-zero if the device's serial number string is serial_number.
+   Only the serial number string is read from the device. */
+static int serial_number_matches(libusb_device *usb_dev,
+                                 const struct libusb_device_descriptor *desc,
+                                 const wchar_t *serial_number)
+{
+	libusb_device_handle *handle;
+	wchar_t *str;
+	int match = 0;
+
+	if (desc->iSerialNumber == 0)
+		return 0;
+	if (libusb_open(usb_dev, &handle) < 0)
+		return 0;
+
+	str = get_usb_string(handle, desc->iSerialNumber);
+	libusb_close(handle);
+
+	if (str) {
+		match = (wcscmp(serial_number, str) == 0);
+		free(str);
+	}
+
+	return match;
+}
+
 
 int HID_API_EXPORT hid_init(void)
 {
@@ -396,6 +536,7 @@ int HID_API_EXPORT hid_init(void)
 int HID_API_EXPORT hid_exit(void)
 {
 	if (initialized) {
+		hid_hotplug_deregister();
 		libusb_exit(NULL);
 		initialized = 0;
 	}
@@ -403,7 +544,7 @@ int HID_API_EXPORT hid_exit(void)
 	return 0;
 }
 
-struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+struct hid_device_info  HID_API_EXPORT *hid_enumerate_ex(unsigned short vendor_id, unsigned short product_id, int flags)
 {
 	libusb_device **devs;
 	libusb_device *dev;
@@ -436,6 +577,12 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 		if (desc.bDeviceClass != LIBUSB_CLASS_PER_INTERFACE)
 			continue;
 
+		/* Check the VID/PID against the arguments before fetching the
+		   configuration descriptor of a device which can't match. */
+		if ((vendor_id != 0x0 || product_id != 0x0) &&
+		    (vendor_id != dev_vid || product_id != dev_pid))
+			continue;
+
 		res = libusb_get_active_config_descriptor(dev, &conf_desc);
 		if (res < 0)
 			libusb_get_config_descriptor(dev, 0, &conf_desc);
@@ -448,9 +595,7 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 					if (intf_desc->bInterfaceClass == LIBUSB_CLASS_HID) {
 						interface_num = intf_desc->bInterfaceNumber;
 
-						/* Check the VID/PID against the arguments */
-						if ((vendor_id == 0x0 && product_id == 0x0) ||
-						    (vendor_id == dev_vid && product_id == dev_pid)) {
+						{
 							struct hid_device_info *tmp;
 
 							/* VID/PID match. Create the record. */
@@ -467,21 +612,16 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 							cur_dev->next = NULL;
 							cur_dev->path = make_path(dev, interface_num);
 							
-							res = libusb_open(dev, &handle);
+							/* Opening the device and reading its strings
+							   is the slow part of enumeration; skip it if
+							   the caller will fetch them later, if at all. */
+							if (flags & HID_ENUM_SKIP_STRINGS)
+								res = -1;
+							else
+								res = libusb_open(dev, &handle);
 
 							if (res >= 0) {
-								/* Serial Number */
-								if (desc.iSerialNumber > 0)
-									cur_dev->serial_number =
-										get_usb_string(handle, desc.iSerialNumber);
-
-								/* Manufacturer and Product strings */
-								if (desc.iManufacturer > 0)
-									cur_dev->manufacturer_string =
-										get_usb_string(handle, desc.iManufacturer);
-								if (desc.iProduct > 0)
-									cur_dev->product_string =
-										get_usb_string(handle, desc.iProduct);
+								fill_info_strings(handle, &desc, cur_dev);
 
 #ifdef INVASIVE_GET_USAGE
 							/*
@@ -580,54 +720,202 @@ void  HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
 	}
 }
 
-hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, wchar_t *serial_number)
+struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
 {
-	struct hid_device_info *devs, *cur_dev;
-	const char *path_to_open = NULL;
-	hid_device *handle = NULL;
-	
-	devs = hid_enumerate(vendor_id, product_id);
-	cur_dev = devs;
-	while (cur_dev) {
-		if (cur_dev->vendor_id == vendor_id &&
-		    cur_dev->product_id == product_id) {
-			if (serial_number) {
-				if (wcscmp(serial_number, cur_dev->serial_number) == 0) {
-					path_to_open = cur_dev->path;
-					break;
-				}
-			}
-			else {
-				path_to_open = cur_dev->path;
-				break;
-			}
+	return hid_enumerate_ex(vendor_id, product_id, 0);
+}
+
+int HID_API_EXPORT hid_get_info_strings(struct hid_device_info *info)
+{
+	libusb_device **devs;
+	libusb_device *usb_dev;
+	libusb_device_handle *handle;
+	int bus, address, interface_num;
+	int res = -1;
+	int d = 0;
+
+	if (parse_path(info->path, &bus, &address, &interface_num) < 0)
+		return -1;
+
+	setlocale(LC_ALL,"");
+
+	if (!initialized)
+		hid_init();
+
+	if (libusb_get_device_list(NULL, &devs) < 0)
+		return -1;
+	while ((usb_dev = devs[d++]) != NULL) {
+		struct libusb_device_descriptor desc;
+
+		if (libusb_get_bus_number(usb_dev) != bus ||
+		    libusb_get_device_address(usb_dev) != address)
+			continue;
+
+		if (libusb_get_device_descriptor(usb_dev, &desc) >= 0 &&
+		    libusb_open(usb_dev, &handle) >= 0) {
+			fill_info_strings(handle, &desc, info);
+			libusb_close(handle);
+			res = 0;
 		}
-		cur_dev = cur_dev->next;
+		break;
 	}
 
-	if (path_to_open) {
-		/* Open the device */
-		handle = hid_open_path(path_to_open);
+	libusb_free_device_list(devs, 1);
+
+	return res;
+}
+
+hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, wchar_t *serial_number)
+{
+	libusb_device **devs;
+	libusb_device *usb_dev;
+	hid_device *dev;
+	int d = 0;
+	int good_open = 0;
+
+	setlocale(LC_ALL,"");
+
+	if (!initialized)
+		hid_init();
+
+	/* Walk the device list once, opening only the device which is
+	   actually wanted. This avoids building a full enumeration (with
+	   all of its string descriptor requests) just to find one path. */
+	if (libusb_get_device_list(NULL, &devs) < 0)
+		return NULL;
+
+	dev = new_hid_device();
+
+	while (!good_open && (usb_dev = devs[d++]) != NULL) {
+		struct libusb_device_descriptor desc;
+		struct libusb_config_descriptor *conf_desc = NULL;
+		const struct libusb_interface_descriptor *intf_desc;
+
+		/* The device descriptor is cached by libusb, so filtering on it
+		   doesn't generate any bus traffic. */
+		if (libusb_get_device_descriptor(usb_dev, &desc) < 0)
+			continue;
+		if (desc.bDeviceClass != LIBUSB_CLASS_PER_INTERFACE ||
+		    desc.idVendor != vendor_id ||
+		    desc.idProduct != product_id)
+			continue;
+
+		if (serial_number &&
+		    !serial_number_matches(usb_dev, &desc, serial_number))
+			continue;
+
+		if (libusb_get_active_config_descriptor(usb_dev, &conf_desc) < 0)
+			continue;
+		intf_desc = find_hid_interface(conf_desc, -1);
+		if (intf_desc)
+			good_open = open_interface(dev, usb_dev, &desc, intf_desc);
+		libusb_free_config_descriptor(conf_desc);
 	}
 
-	hid_free_enumeration(devs);
-	
-	return handle;
+	libusb_free_device_list(devs, 1);
+
+	if (good_open) {
+		return dev;
+	}
+	else {
+		free_hid_device(dev);
+		return NULL;
+	}
+}
+
+/* Hands a report's transfer back to libusb to be filled again, unless
+   the device is being shut down. Must be called with dev->mutex held. */
+static void submit_read(hid_device *dev, struct input_report *rpt)
+{
+	if (dev->shutdown_thread)
+		return;
+
+#ifdef REPORT_LATENCY_TRACE
+	clock_gettime(CLOCK_MONOTONIC, &rpt->submitted);
+#endif
+	if (libusb_submit_transfer(rpt->transfer) == 0) {
+		dev->transfers_in_flight++;
+		dev->stats.resubmits++;
+	}
+}
+
+#ifdef REPORT_LATENCY_TRACE
+static void add_latency(struct hid_latency *lat, const struct timespec *from, const struct timespec *to)
+{
+	unsigned long us = (to->tv_sec - from->tv_sec) * 1000000L +
+	                   (to->tv_nsec - from->tv_nsec) / 1000;
+
+	if (lat->count == 0 || us < lat->min_us)
+		lat->min_us = us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+	lat->total_us += us;
+	lat->count++;
+}
+#endif
+
+/* Accounts for a report being collected by the application. Must be
+   called with dev->mutex held. */
+static void report_dequeued(hid_device *dev, struct input_report *rpt)
+{
+#ifdef REPORT_LATENCY_TRACE
+	struct trace_entry *entry = &dev->trace[dev->trace_next];
+
+	clock_gettime(CLOCK_MONOTONIC, &entry->dequeued);
+	entry->submitted = rpt->submitted;
+	entry->head = rpt->head;
+	entry->completed = rpt->completed;
+	entry->enqueued = rpt->enqueued;
+	dev->trace_next = (dev->trace_next + 1) % TRACE_DEPTH;
+
+	add_latency(&dev->stats.submit_to_head, &entry->submitted, &entry->head);
+	add_latency(&dev->stats.head_to_complete, &entry->head, &entry->completed);
+	add_latency(&dev->stats.complete_to_enqueue, &entry->completed, &entry->enqueued);
+	add_latency(&dev->stats.enqueue_to_dequeue, &entry->enqueued, &entry->dequeued);
+#endif
+	dev->stats.queue_length--;
 }
 
 static void read_callback(struct libusb_transfer *transfer)
 {
-	hid_device *dev = transfer->user_data;
-	
+	struct input_report *rpt = transfer->user_data;
+	hid_device *dev = rpt->dev;
+
+#ifdef REPORT_LATENCY_TRACE
+	clock_gettime(CLOCK_MONOTONIC, &rpt->completed);
+#endif
+
+	pthread_mutex_lock(&dev->mutex);
+	dev->transfers_in_flight--;
+
+#ifdef REPORT_LATENCY_TRACE
+	/* Transfers on the endpoint complete in the order they were
+	   submitted, so this one has been the oldest in flight since the
+	   previous one completed, or since it was submitted if that was
+	   later. */
+	if (rpt->submitted.tv_sec > dev->last_completed.tv_sec ||
+	    (rpt->submitted.tv_sec == dev->last_completed.tv_sec &&
+	     rpt->submitted.tv_nsec > dev->last_completed.tv_nsec))
+		rpt->head = rpt->submitted;
+	else
+		rpt->head = dev->last_completed;
+	dev->last_completed = rpt->completed;
+#endif
+
 	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
 
-		struct input_report *rpt = malloc(sizeof(*rpt));
-		rpt->data = malloc(transfer->actual_length);
-		memcpy(rpt->data, transfer->buffer, transfer->actual_length);
+		/* The report stays in the transfer's buffer. The transfer
+		   is resubmitted once the report has been consumed. */
 		rpt->len = transfer->actual_length;
 		rpt->next = NULL;
 
-		pthread_mutex_lock(&dev->mutex);
+		dev->stats.reports++;
+		dev->stats.queue_length++;
+		if (dev->stats.queue_length > dev->stats.queue_high_water)
+			dev->stats.queue_high_water = dev->stats.queue_length;
+#ifdef REPORT_LATENCY_TRACE
+		clock_gettime(CLOCK_MONOTONIC, &rpt->enqueued);
+#endif
 
 		/* Attach the new report object to the end of the list. */
 		if (dev->input_reports == NULL) {
@@ -638,63 +926,105 @@ static void read_callback(struct libusb_transfer *transfer)
 		else {
 			/* Find the end of the list and attach. */
 			struct input_report *cur = dev->input_reports;
-			int num_queued = 0;
 			while (cur->next != NULL) {
 				cur = cur->next;
-				num_queued++;
 			}
 			cur->next = rpt;
 			
-			/* Pop one off if we've reached 30 in the queue. This
-			   way we don't grow forever if the user never reads
-			   anything from the device. */
-			if (num_queued > 30) {
+			/* Pop one off if no transfer is left reading from the
+			   device. This way reading doesn't stop if the user
+			   never reads anything from the device. */
+			if (dev->transfers_in_flight == 0) {
 				return_data(dev, NULL, 0);
-			}			
+				dev->stats.drops++;
+			}
 		}
 		pthread_mutex_unlock(&dev->mutex);
+		return;
 	}
 	else if (transfer->status == LIBUSB_TRANSFER_CANCELLED) {
 		dev->shutdown_thread = 1;
+		pthread_mutex_unlock(&dev->mutex);
 		return;
 	}
 	else if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
 		dev->shutdown_thread = 1;
+		pthread_mutex_unlock(&dev->mutex);
 		return;
 	}
 	else if (transfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
 		//LOG("Timeout (normal)\n");
+		dev->stats.transfer_timeouts++;
 	}
 	else {
 		LOG("Unknown transfer code: %d\n", transfer->status);
+		dev->stats.transfer_errors++;
 	}
 	
 	/* Re-submit the transfer object. */
-	libusb_submit_transfer(transfer);
+	submit_read(dev, rpt);
+	pthread_mutex_unlock(&dev->mutex);
 }
 
 
+/* Frees the transfer objects and their buffers, including a partly
+   allocated set, and leaves read_slots NULL. */
+static void free_read_slots(hid_device *dev)
+{
+	int i;
+
+	if (!dev->read_slots)
+		return;
+
+	for (i = 0; i < NUM_READ_TRANSFERS; i++) {
+		free(dev->read_slots[i].data);
+		libusb_free_transfer(dev->read_slots[i].transfer);
+	}
+	free(dev->read_slots);
+	dev->read_slots = NULL;
+}
+
 static void *read_thread(void *param)
 {
 	hid_device *dev = param;
-	unsigned char *buf;
 	const size_t length = dev->input_ep_max_packet_size;
+	int i;
+
+	/* Set up the transfer objects. */
+	dev->read_slots = calloc(NUM_READ_TRANSFERS, sizeof(struct input_report));
+	for (i = 0; dev->read_slots && i < NUM_READ_TRANSFERS; i++) {
+		struct input_report *rpt = &dev->read_slots[i];
+		rpt->dev = dev;
+		rpt->data = malloc(length);
+		rpt->transfer = libusb_alloc_transfer(0);
+		if (!rpt->data || !rpt->transfer)
+			break;
+		libusb_fill_interrupt_transfer(rpt->transfer,
+			dev->device_handle,
+			dev->input_endpoint,
+			rpt->data,
+			length,
+			read_callback,
+			rpt,
+			5000/*timeout*/);
+	}
 
-	/* Set up the transfer object. */
-	buf = malloc(length);
-	dev->transfer = libusb_alloc_transfer(0);
-	libusb_fill_interrupt_transfer(dev->transfer,
-		dev->device_handle,
-		dev->input_endpoint,
-		buf,
-		length,
-		read_callback,
-		dev,
-		5000/*timeout*/);
+	/* If any of them couldn't be allocated, tell open_interface() by
+	   leaving read_slots NULL, and end here. */
+	if (i < NUM_READ_TRANSFERS) {
+		LOG("can't allocate the read transfers\n");
+		free_read_slots(dev);
+		pthread_barrier_wait(&dev->barrier);
+		return NULL;
+	}
 	
-	/* Make the first submission. Further submissions are made
-	   from inside read_callback() */
-	libusb_submit_transfer(dev->transfer);
+	/* Make the first submissions. Further submissions are made
+	   from inside read_callback() and as reports are consumed. */
+	pthread_mutex_lock(&dev->mutex);
+	for (i = 0; i < NUM_READ_TRANSFERS; i++)
+		submit_read(dev, &dev->read_slots[i]);
+	dev->stats.resubmits = 0; /* those were the first submissions */
+	pthread_mutex_unlock(&dev->mutex);
 
 	// Notify the main thread that the read thread is up and running.
 	pthread_barrier_wait(&dev->barrier);
@@ -709,11 +1039,23 @@ static void *read_thread(void *param)
 		}
 	}
 	
-	/* Cancel any transfer that may be pending. This call will fail
-	   if no transfers are pending, but that's OK. */
-	if (libusb_cancel_transfer(dev->transfer) == 0) {
-		/* The transfer was cancelled, so wait for its completion. */
-		libusb_handle_events(NULL);
+	/* Cancel any transfers that may be pending. These calls will fail
+	   for transfers which aren't pending, but that's OK. Nothing is
+	   resubmitted once shutdown_thread is set. */
+	pthread_mutex_lock(&dev->mutex);
+	dev->shutdown_thread = 1;
+	for (i = 0; i < NUM_READ_TRANSFERS; i++)
+		libusb_cancel_transfer(dev->read_slots[i].transfer);
+	pthread_mutex_unlock(&dev->mutex);
+
+	/* Wait for the cancelled transfers to complete. */
+	for (;;) {
+		int in_flight;
+		pthread_mutex_lock(&dev->mutex);
+		in_flight = dev->transfers_in_flight;
+		pthread_mutex_unlock(&dev->mutex);
+		if (in_flight <= 0 || libusb_handle_events(NULL) < 0)
+			break;
 	}
 	
 	/* Now that the read thread is stopping, Wake any threads which are
@@ -725,8 +1067,8 @@ static void *read_thread(void *param)
 	pthread_cond_broadcast(&dev->condition);
 	pthread_mutex_unlock(&dev->mutex);
 
-	/* The dev->transfer->buffer and dev->transfer objects are cleaned up
-	   in hid_close(). They are not cleaned up here because this thread
+	/* The transfer objects and their buffers are cleaned up in
+	   hid_close(). They are not cleaned up here because this thread
 	   could end either due to a disconnect or due to a user
 	   call to hid_close(). In both cases the objects can be safely
 	   cleaned up after the call to pthread_join() (in hid_close()), but
@@ -737,16 +1079,109 @@ static void *read_thread(void *param)
 }
 
 
+/* Opens the HID interface intf_desc of usb_dev into dev and starts its
+   read thread. Returns 1 on success. On failure nothing is left open and
+   0 is returned. */
+static int open_interface(hid_device *dev, libusb_device *usb_dev,
+                          const struct libusb_device_descriptor *desc,
+                          const struct libusb_interface_descriptor *intf_desc)
+{
+	int res;
+	int i;
+
+	res = libusb_open(usb_dev, &dev->device_handle);
+	if (res < 0) {
+		LOG("can't open device\n");
+		return 0;
+	}
+
+	/* Detach the kernel driver, but only if the
+	   device is managed by the kernel */
+	if (libusb_kernel_driver_active(dev->device_handle, intf_desc->bInterfaceNumber) == 1) {
+		res = libusb_detach_kernel_driver(dev->device_handle, intf_desc->bInterfaceNumber);
+		if (res < 0) {
+			libusb_close(dev->device_handle);
+			LOG("Unable to detach Kernel Driver\n");
+			return 0;
+		}
+	}
+
+	res = libusb_claim_interface(dev->device_handle, intf_desc->bInterfaceNumber);
+	if (res < 0) {
+		LOG("can't claim interface %d: %d\n", intf_desc->bInterfaceNumber, res);
+		libusb_close(dev->device_handle);
+		return 0;
+	}
+
+	/* Store off the string descriptor indexes */
+	dev->manufacturer_index = desc->iManufacturer;
+	dev->product_index      = desc->iProduct;
+	dev->serial_index       = desc->iSerialNumber;
+
+	/* Store off the interface number */
+	dev->interface = intf_desc->bInterfaceNumber;
+
+	/* Find the INPUT and OUTPUT endpoints. An
+	   OUTPUT endpoint is not required. */
+	for (i = 0; i < intf_desc->bNumEndpoints; i++) {
+		const struct libusb_endpoint_descriptor *ep
+			= &intf_desc->endpoint[i];
+
+		/* Determine the type and direction of this
+		   endpoint. */
+		int is_interrupt =
+			(ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK)
+		      == LIBUSB_TRANSFER_TYPE_INTERRUPT;
+		int is_output = 
+			(ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK)
+		      == LIBUSB_ENDPOINT_OUT;
+		int is_input = 
+			(ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK)
+		      == LIBUSB_ENDPOINT_IN;
+
+		/* Decide whether to use it for intput or output. */
+		if (dev->input_endpoint == 0 &&
+		    is_interrupt && is_input) {
+			/* Use this endpoint for INPUT */
+			dev->input_endpoint = ep->bEndpointAddress;
+			dev->input_ep_max_packet_size = ep->wMaxPacketSize;
+		}
+		if (dev->output_endpoint == 0 &&
+		    is_interrupt && is_output) {
+			/* Use this endpoint for OUTPUT */
+			dev->output_endpoint = ep->bEndpointAddress;
+		}
+	}
+
+	if (pthread_create(&dev->thread, NULL, read_thread, dev) != 0) {
+		LOG("can't start the read thread\n");
+		libusb_release_interface(dev->device_handle, dev->interface);
+		libusb_close(dev->device_handle);
+		return 0;
+	}
+
+	// Wait here for the read thread to be initialized.
+	pthread_barrier_wait(&dev->barrier);
+
+	/* The read thread has already ended if it couldn't set up its
+	   transfers. */
+	if (!dev->read_slots) {
+		pthread_join(dev->thread, NULL);
+		libusb_release_interface(dev->device_handle, dev->interface);
+		libusb_close(dev->device_handle);
+		return 0;
+	}
+
+	return 1;
+}
+
 hid_device * HID_API_EXPORT hid_open_path(const char *path)
 {
 	hid_device *dev = NULL;
 
-	dev = new_hid_device();
-
 	libusb_device **devs;
 	libusb_device *usb_dev;
-	ssize_t num_devs;
-	int res;
+	int bus, address, interface_num;
 	int d = 0;
 	int good_open = 0;
 	
@@ -755,108 +1190,34 @@ hid_device * HID_API_EXPORT hid_open_path(const char *path)
 	if (!initialized)
 		hid_init();
 
-	num_devs = libusb_get_device_list(NULL, &devs);
+	/* The path already names the bus, the device address and the
+	   interface, so only the matching device's descriptors are read. */
+	if (parse_path(path, &bus, &address, &interface_num) < 0)
+		return NULL;
+
+	if (libusb_get_device_list(NULL, &devs) < 0)
+		return NULL;
+
+	dev = new_hid_device();
+
 	while ((usb_dev = devs[d++]) != NULL) {
 		struct libusb_device_descriptor desc;
 		struct libusb_config_descriptor *conf_desc = NULL;
-		int i,j,k;
-		libusb_get_device_descriptor(usb_dev, &desc);
+		const struct libusb_interface_descriptor *intf_desc;
 
-		if (libusb_get_active_config_descriptor(usb_dev, &conf_desc) < 0)
+		if (libusb_get_bus_number(usb_dev) != bus ||
+		    libusb_get_device_address(usb_dev) != address)
 			continue;
-		for (j = 0; j < conf_desc->bNumInterfaces; j++) {
-			const struct libusb_interface *intf = &conf_desc->interface[j];
-			for (k = 0; k < intf->num_altsetting; k++) {
-				const struct libusb_interface_descriptor *intf_desc;
-				intf_desc = &intf->altsetting[k];
-				if (intf_desc->bInterfaceClass == LIBUSB_CLASS_HID) {
-					char *dev_path = make_path(usb_dev, intf_desc->bInterfaceNumber);
-					if (!strcmp(dev_path, path)) {
-						/* Matched Paths. Open this device */
-
-						// OPEN HERE //
-						res = libusb_open(usb_dev, &dev->device_handle);
-						if (res < 0) {
-							LOG("can't open device\n");
-							free(dev_path);
- 							break;
-						}
-						good_open = 1;
-						
-						/* Detach the kernel driver, but only if the
-						   device is managed by the kernel */
-						if (libusb_kernel_driver_active(dev->device_handle, intf_desc->bInterfaceNumber) == 1) {
-							res = libusb_detach_kernel_driver(dev->device_handle, intf_desc->bInterfaceNumber);
-							if (res < 0) {
-								libusb_close(dev->device_handle);
-								LOG("Unable to detach Kernel Driver\n");
-								free(dev_path);
-								good_open = 0;
-								break;
-							}
-						}
-						
-						res = libusb_claim_interface(dev->device_handle, intf_desc->bInterfaceNumber);
-						if (res < 0) {
-							LOG("can't claim interface %d: %d\n", intf_desc->bInterfaceNumber, res);
-							free(dev_path);
-							libusb_close(dev->device_handle);
-							good_open = 0;
-							break;
-						}
 
-						/* Store off the string descriptor indexes */
-						dev->manufacturer_index = desc.iManufacturer;
-						dev->product_index      = desc.iProduct;
-						dev->serial_index       = desc.iSerialNumber;
-
-						/* Store off the interface number */
-						dev->interface = intf_desc->bInterfaceNumber;
-												
-						/* Find the INPUT and OUTPUT endpoints. An
-						   OUTPUT endpoint is not required. */
-						for (i = 0; i < intf_desc->bNumEndpoints; i++) {
-							const struct libusb_endpoint_descriptor *ep
-								= &intf_desc->endpoint[i];
-
-							/* Determine the type and direction of this
-							   endpoint. */
-							int is_interrupt =
-								(ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK)
-							      == LIBUSB_TRANSFER_TYPE_INTERRUPT;
-							int is_output = 
-								(ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK)
-							      == LIBUSB_ENDPOINT_OUT;
-							int is_input = 
-								(ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK)
-							      == LIBUSB_ENDPOINT_IN;
-
-							/* Decide whether to use it for intput or output. */
-							if (dev->input_endpoint == 0 &&
-							    is_interrupt && is_input) {
-								/* Use this endpoint for INPUT */
-								dev->input_endpoint = ep->bEndpointAddress;
-								dev->input_ep_max_packet_size = ep->wMaxPacketSize;
-							}
-							if (dev->output_endpoint == 0 &&
-							    is_interrupt && is_output) {
-								/* Use this endpoint for OUTPUT */
-								dev->output_endpoint = ep->bEndpointAddress;
-							}
-						}
-						
-						pthread_create(&dev->thread, NULL, read_thread, dev);
-						
-						// Wait here for the read thread to be initialized.
-						pthread_barrier_wait(&dev->barrier);
-						
-					}
-					free(dev_path);
-				}
-			}
-		}
-		libusb_free_config_descriptor(conf_desc);
+		libusb_get_device_descriptor(usb_dev, &desc);
 
+		if (libusb_get_active_config_descriptor(usb_dev, &conf_desc) < 0)
+			break;
+		intf_desc = find_hid_interface(conf_desc, interface_num);
+		if (intf_desc)
+			good_open = open_interface(dev, usb_dev, &desc, intf_desc);
+		libusb_free_config_descriptor(conf_desc);
+		break;
 	}
 
 	libusb_free_device_list(devs, 1);
@@ -928,14 +1289,18 @@ int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t
 static int return_data(hid_device *dev, unsigned char *data, size_t length)
 {
 	/* Copy the data out of the linked list item (rpt) into the
-	   return buffer (data), and delete the liked list item. */
+	   return buffer (data), remove the linked list item, and give its
+	   transfer back to libusb. */
 	struct input_report *rpt = dev->input_reports;
 	size_t len = (length < rpt->len)? length: rpt->len;
 	if (len > 0)
 		memcpy(data, rpt->data, len);
 	dev->input_reports = rpt->next;
-	free(rpt->data);
-	free(rpt);
+	if (data)
+		report_dequeued(dev, rpt);
+	else
+		dev->stats.queue_length--; /* dropped */
+	submit_read(dev, rpt);
 	return len;
 }
 
@@ -946,48 +1311,34 @@ static void cleanup_mutex(void *param)
 }
 
 
-int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+/* Waits, with dev->mutex held, for an input report to be queued.
+   Returns 1 once there is one, 0 if the timeout expires first and -1 if
+   the device has gone away or the wait failed. A timeout of -1 waits
+   forever and 0 doesn't wait at all. */
+static int wait_for_report(hid_device *dev, int milliseconds)
 {
-	int bytes_read = -1;
-
-#if 0
-	int transferred;
-	int res = libusb_interrupt_transfer(dev->device_handle, dev->input_endpoint, data, length, &transferred, 5000);
-	LOG("transferred: %d\n", transferred);
-	return transferred;
-#endif
+	/* There's an input report queued up already. */
+	if (dev->input_reports)
+		return 1;
 
-	pthread_mutex_lock(&dev->mutex);
-	pthread_cleanup_push(&cleanup_mutex, dev);
-
-	/* There's an input report queued up. Return it. */
-	if (dev->input_reports) {
-		/* Return the first one */
-		bytes_read = return_data(dev, data, length);
-		goto ret;
-	}
-	
 	if (dev->shutdown_thread) {
 		/* This means the device has been disconnected.
 		   An error code of -1 should be returned. */
-		bytes_read = -1;
-		goto ret;
+		return -1;
 	}
-	
+
 	if (milliseconds == -1) {
 		/* Blocking */
 		while (!dev->input_reports && !dev->shutdown_thread) {
 			pthread_cond_wait(&dev->condition, &dev->mutex);
 		}
-		if (dev->input_reports) {
-			bytes_read = return_data(dev, data, length);
-		}
 	}
 	else if (milliseconds > 0) {
-		/* Non-blocking, but called with timeout. */
+		/* Non-blocking, but called with timeout. The condition
+		   was created to use CLOCK_MONOTONIC. */
 		int res;
 		struct timespec ts;
-		clock_gettime(CLOCK_REALTIME, &ts);
+		clock_gettime(CLOCK_MONOTONIC, &ts);
 		ts.tv_sec += milliseconds / 1000;
 		ts.tv_nsec += (milliseconds % 1000) * 1000000;
 		if (ts.tv_nsec >= 1000000000L) {
@@ -997,40 +1348,218 @@ int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t
 		
 		while (!dev->input_reports && !dev->shutdown_thread) {
 			res = pthread_cond_timedwait(&dev->condition, &dev->mutex, &ts);
-			if (res == 0) {
-				if (dev->input_reports) {
-					bytes_read = return_data(dev, data, length);
-					break;
-				}
-				
-				/* If we're here, there was a spurious wake up
-				   or the read thread was shutdown. Run the
-				   loop again (ie: don't break). */
-			}
-			else if (res == ETIMEDOUT) {
-				/* Timed out. */
-				bytes_read = 0;
-				break;
+			if (res == ETIMEDOUT) {
+				/* Timed out, unless a report arrived just
+				   as the deadline passed. */
+				if (dev->input_reports)
+					return 1;
+				dev->stats.read_timeouts++;
+				return 0;
 			}
-			else {
+			else if (res != 0) {
 				/* Error. */
-				bytes_read = -1;
-				break;
+				return -1;
 			}
+
+			/* If we're here, there was a spurious wake up
+			   or the read thread was shutdown. Run the
+			   loop again (ie: don't break). */
 		}
 	}
 	else {
 		/* Purely non-blocking */
-		bytes_read = 0;
+		return 0;
+	}
+
+	/* The loop only ends without a report if the read thread stopped. */
+	return (dev->input_reports)? 1: -1;
+}
+
+int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	int bytes_read = -1;
+
+#if 0
+	int transferred;
+	int res = libusb_interrupt_transfer(dev->device_handle, dev->input_endpoint, data, length, &transferred, 5000);
+	LOG("transferred: %d\n", transferred);
+	return transferred;
+#endif
+
+	pthread_mutex_lock(&dev->mutex);
+	pthread_cleanup_push(&cleanup_mutex, dev);
+
+	bytes_read = wait_for_report(dev, milliseconds);
+	if (bytes_read > 0) {
+		/* Return the first one */
+		bytes_read = return_data(dev, data, length);
 	}
 
-ret:
 	pthread_mutex_unlock(&dev->mutex);
 	pthread_cleanup_pop(0);
 
 	return bytes_read;
 }
 
+int HID_API_EXPORT hid_read_many(hid_device *dev, unsigned char *data, size_t report_size, size_t *lengths, int max_reports, int milliseconds)
+{
+	int num_read = 0;
+	int res;
+
+	/* 0 is kept for a timeout, so a request for no reports is an error. */
+	if (max_reports <= 0 || !data || !lengths)
+		return -1;
+
+	pthread_mutex_lock(&dev->mutex);
+	pthread_cleanup_push(&cleanup_mutex, dev);
+
+	/* Only the first report is waited for. Everything which is queued
+	   behind it is then taken without dropping the lock. */
+	res = wait_for_report(dev, milliseconds);
+	if (res > 0) {
+		while (dev->input_reports && num_read < max_reports) {
+			lengths[num_read] = return_data(dev, data, report_size);
+			data += report_size;
+			num_read++;
+		}
+	}
+	else {
+		num_read = res;
+	}
+
+	pthread_mutex_unlock(&dev->mutex);
+	pthread_cleanup_pop(0);
+
+	return num_read;
+}
+
+int HID_API_EXPORT hid_read_borrow(hid_device *dev, const unsigned char **data, int milliseconds)
+{
+	struct input_report *rpt;
+	int res;
+
+	*data = NULL;
+
+	pthread_mutex_lock(&dev->mutex);
+	pthread_cleanup_push(&cleanup_mutex, dev);
+
+	res = wait_for_report(dev, milliseconds);
+	if (res > 0) {
+		/* Unlink the first report, but keep its transfer out of use
+		   until hid_read_release(). */
+		rpt = dev->input_reports;
+		dev->input_reports = rpt->next;
+		rpt->next = NULL;
+		report_dequeued(dev, rpt);
+
+		res = rpt->len;
+		if (res > 0) {
+			*data = rpt->data;
+			rpt->lent = 1;
+		}
+		else
+			submit_read(dev, rpt); /* nothing to lend */
+	}
+
+	pthread_mutex_unlock(&dev->mutex);
+	pthread_cleanup_pop(0);
+
+	return res;
+}
+
+int HID_API_EXPORT hid_read_release(hid_device *dev, const unsigned char *data)
+{
+	int res = -1;
+	int i;
+
+	pthread_mutex_lock(&dev->mutex);
+	for (i = 0; i < NUM_READ_TRANSFERS; i++) {
+		struct input_report *rpt = &dev->read_slots[i];
+		if (rpt->data == data && rpt->lent) {
+			rpt->lent = 0;
+			submit_read(dev, rpt);
+			res = 0;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&dev->mutex);
+
+	return res;
+}
+
+int HID_API_EXPORT hid_get_stats(hid_device *dev, struct hid_stats *stats)
+{
+	pthread_mutex_lock(&dev->mutex);
+	*stats = dev->stats;
+	pthread_mutex_unlock(&dev->mutex);
+
+#ifdef REPORT_LATENCY_TRACE
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+#ifdef REPORT_LATENCY_TRACE
+static void dump_latency(const char *name, const struct hid_latency *lat)
+{
+	if (lat->count == 0)
+		return;
+
+	fprintf(stderr, "  %-20s min %lu us, mean %llu us, max %lu us\n", name,
+		lat->min_us, lat->total_us / lat->count, lat->max_us);
+}
+
+static long trace_us(const struct timespec *t, const struct timespec *base)
+{
+	return (t->tv_sec - base->tv_sec) * 1000000L +
+	       (t->tv_nsec - base->tv_nsec) / 1000;
+}
+#endif
+
+void HID_API_EXPORT hid_dump_stats(hid_device *dev)
+{
+	struct hid_stats stats;
+#ifdef REPORT_LATENCY_TRACE
+	struct trace_entry trace[TRACE_DEPTH];
+	unsigned i, next;
+
+	pthread_mutex_lock(&dev->mutex);
+	memcpy(trace, dev->trace, sizeof(trace));
+	next = dev->trace_next;
+	pthread_mutex_unlock(&dev->mutex);
+#endif
+
+	hid_get_stats(dev, &stats);
+
+	fprintf(stderr, "hidapi: %lu reports, %lu dropped, %lu resubmits, "
+		"%lu transfer timeouts, %lu transfer errors, %lu read timeouts, "
+		"queue high water %u\n",
+		stats.reports, stats.drops, stats.resubmits,
+		stats.transfer_timeouts, stats.transfer_errors,
+		stats.read_timeouts, stats.queue_high_water);
+
+#ifdef REPORT_LATENCY_TRACE
+	dump_latency("submit -> oldest", &stats.submit_to_head);
+	dump_latency("oldest -> complete", &stats.head_to_complete);
+	dump_latency("complete -> enqueue", &stats.complete_to_enqueue);
+	dump_latency("enqueue -> dequeue", &stats.enqueue_to_dequeue);
+
+	/* Oldest first, relative to each report's submission, in us. */
+	fprintf(stderr, "    oldest complete enqueue dequeue\n");
+	for (i = 0; i < TRACE_DEPTH; i++) {
+		const struct trace_entry *e = &trace[(next + i) % TRACE_DEPTH];
+		if (e->dequeued.tv_sec == 0 && e->dequeued.tv_nsec == 0)
+			continue;
+		fprintf(stderr, "  %8ld %8ld %7ld %7ld\n",
+			trace_us(&e->head, &e->submitted),
+			trace_us(&e->completed, &e->submitted),
+			trace_us(&e->enqueued, &e->submitted),
+			trace_us(&e->dequeued, &e->submitted));
+	}
+#endif
+}
+
 int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
 {
 	return hid_read_timeout(dev, data, length, dev->blocking ? -1 : 0);
@@ -1107,19 +1636,23 @@ int HID_API_EXPORT hid_get_feature_report(hid_device *dev, unsigned char *data,
 
 void HID_API_EXPORT hid_close(hid_device *dev)
 {
+	int i;
+
 	if (!dev)
 		return;
 	
 	/* Cause read_thread() to stop. */
+	pthread_mutex_lock(&dev->mutex);
 	dev->shutdown_thread = 1;
-	libusb_cancel_transfer(dev->transfer);
+	for (i = 0; i < NUM_READ_TRANSFERS; i++)
+		libusb_cancel_transfer(dev->read_slots[i].transfer);
+	pthread_mutex_unlock(&dev->mutex);
 
 	/* Wait for read_thread() to end. */
 	pthread_join(dev->thread, NULL);
 	
 	/* Clean up the Transfer objects allocated in read_thread(). */
-	free(dev->transfer->buffer);
-	libusb_free_transfer(dev->transfer);
+	free_read_slots(dev);
 	
 	/* release the interface */
 	libusb_release_interface(dev->device_handle, dev->interface);
@@ -1127,12 +1660,9 @@ void HID_API_EXPORT hid_close(hid_device *dev)
 	/* Close the handle */
 	libusb_close(dev->device_handle);
 	
-	/* Clear out the queue of received reports. */
-	pthread_mutex_lock(&dev->mutex);
-	while (dev->input_reports) {
-		return_data(dev, NULL, 0);
-	}
-	pthread_mutex_unlock(&dev->mutex);
+	/* The queue of received reports lived in the transfer buffers,
+	   which are gone now. */
+	dev->input_reports = NULL;
 	
 	free_hid_device(dev);
 }
@@ -1175,6 +1705,162 @@ HID_API_EXPORT const wchar_t * HID_API_CALL  hid_error(hid_device *dev)
 }
 
 
+/* Arrivals reported by libusb are queued here and handed to the user's
+   callback from hid_hotplug_poll(). The libusb callback may run on any
+   thread handling events (including the read thread of an open device),
+   and it isn't allowed to do synchronous I/O, so it can't simply call
+   the user's callback directly. */
+struct hotplug_arrival {
+	char *path;
+	struct hotplug_arrival *next;
+};
+
+static pthread_mutex_t hotplug_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct hotplug_arrival *hotplug_arrivals = NULL;
+static libusb_hotplug_callback_handle hotplug_handle;
+static int hotplug_registered = 0;
+static hid_hotplug_callback hotplug_user_callback = NULL;
+static void *hotplug_user_data = NULL;
+
+static int hotplug_callback(libusb_context *ctx, libusb_device *usb_dev,
+                            libusb_hotplug_event event, void *user_data)
+{
+	struct libusb_config_descriptor *conf_desc = NULL;
+	const struct libusb_interface_descriptor *intf_desc;
+	struct hotplug_arrival *arrival, **tail;
+
+	if (libusb_get_active_config_descriptor(usb_dev, &conf_desc) < 0 &&
+	    libusb_get_config_descriptor(usb_dev, 0, &conf_desc) < 0)
+		return 0;
+
+	intf_desc = find_hid_interface(conf_desc, -1);
+	if (intf_desc) {
+		arrival = malloc(sizeof(*arrival));
+		if (arrival)
+			arrival->path = make_path(usb_dev, intf_desc->bInterfaceNumber);
+
+		if (!arrival || !arrival->path) {
+			/* Out of memory; the arrival is dropped. */
+			LOG("unable to queue hotplug arrival\n");
+			free(arrival);
+		}
+		else {
+			arrival->next = NULL;
+
+			pthread_mutex_lock(&hotplug_mutex);
+			for (tail = &hotplug_arrivals; *tail; tail = &(*tail)->next)
+				;
+			*tail = arrival;
+			pthread_mutex_unlock(&hotplug_mutex);
+		}
+	}
+
+	libusb_free_config_descriptor(conf_desc);
+
+	/* Stay registered. */
+	return 0;
+}
+
+int HID_API_EXPORT hid_hotplug_register(unsigned short vendor_id, unsigned short product_id, hid_hotplug_callback callback, void *user_data)
+{
+	int res;
+
+	if (!initialized && hid_init() < 0)
+		return -1;
+
+	if (hotplug_registered)
+		return -1;
+
+	if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+		LOG("libusb has no hotplug support on this platform\n");
+		return -1;
+	}
+
+	hotplug_user_callback = callback;
+	hotplug_user_data = user_data;
+
+	/* LIBUSB_HOTPLUG_ENUMERATE reports devices which are already attached
+	   as arrivals, so nothing plugged in before this call is missed. */
+	res = libusb_hotplug_register_callback(NULL,
+		LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED,
+		LIBUSB_HOTPLUG_ENUMERATE,
+		vendor_id ? vendor_id : LIBUSB_HOTPLUG_MATCH_ANY,
+		product_id ? product_id : LIBUSB_HOTPLUG_MATCH_ANY,
+		LIBUSB_HOTPLUG_MATCH_ANY,
+		hotplug_callback,
+		NULL,
+		&hotplug_handle);
+	if (res < 0) {
+		LOG("libusb_hotplug_register_callback() failed with %d\n", res);
+		return -1;
+	}
+
+	hotplug_registered = 1;
+
+	return 0;
+}
+
+int HID_API_EXPORT hid_hotplug_poll(int milliseconds)
+{
+	struct timeval tv;
+	struct hotplug_arrival *arrival;
+	int delivered = 0;
+
+	if (!hotplug_registered)
+		return -1;
+
+	/* Let libusb collect pending hotplug events. While a device is open,
+	   its read thread is also handling events, so arrivals can be queued
+	   from there as well. */
+	tv.tv_sec = milliseconds / 1000;
+	tv.tv_usec = (milliseconds % 1000) * 1000;
+	if (libusb_handle_events_timeout(NULL, &tv) < 0)
+		return -1;
+
+	for (;;) {
+		pthread_mutex_lock(&hotplug_mutex);
+		arrival = hotplug_arrivals;
+		if (arrival)
+			hotplug_arrivals = arrival->next;
+		pthread_mutex_unlock(&hotplug_mutex);
+
+		if (!arrival)
+			break;
+
+		/* The callback is made without any lock held, so it is free to
+		   open the device and talk to it. */
+		hotplug_user_callback(arrival->path, hotplug_user_data);
+		delivered++;
+
+		free(arrival->path);
+		free(arrival);
+	}
+
+	return delivered;
+}
+
+void HID_API_EXPORT hid_hotplug_deregister(void)
+{
+	struct hotplug_arrival *arrival;
+
+	if (!hotplug_registered)
+		return;
+
+	libusb_hotplug_deregister_callback(NULL, hotplug_handle);
+	hotplug_registered = 0;
+
+	/* Discard any arrivals which were never delivered. */
+	pthread_mutex_lock(&hotplug_mutex);
+	while (hotplug_arrivals) {
+		arrival = hotplug_arrivals;
+		hotplug_arrivals = arrival->next;
+		free(arrival->path);
+		free(arrival);
+	}
+	pthread_mutex_unlock(&hotplug_mutex);
+}
+
+
 struct lang_map_entry {
 	const char *name;
 	const char *string_code;
@@ -25,10 +25,254 @@
 	#include <windows.h>
 #else
 	#include <unistd.h>
+	#include <time.h>
 #endif
 
 #define REPORT_NUMBER 0x00
 
+// Size of the firmware's reports (EP_1_IN_LEN and EP_1_OUT_LEN).
+#define REPORT_LEN 64
+
+// A report that hasn't arrived by then is taken as lost.
+#define BENCH_TIMEOUT_MS 1000
+
+// Microseconds from an arbitrary start, for the benchmark.
+static double now_us(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, freq;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
+	return count.QuadPart * 1e6 / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+#endif
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void print_percentiles(const char *what, double *v, int n)
+{
+	if (n == 0)
+		return;
+	qsort(v, n, sizeof(*v), compare_double);
+	printf("%s: min %.0f  p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n", what,
+	       v[0], v[(n - 1) / 2], v[(int)((n - 1) * 0.9)],
+	       v[(int)((n - 1) * 0.99)], v[n - 1]);
+}
+
+// Wait for the reply to a command, passing over anything else (such as the
+// tail of a stream).
+static int read_reply(hid_device *handle, unsigned char *in, unsigned char command)
+{
+	int res;
+
+	do
+		res = hid_read_timeout(handle, in, REPORT_LEN, BENCH_TIMEOUT_MS);
+	while (res > 0 && in[0] != command);
+	return res;
+}
+
+// Command 0x82: each report is echoed back; one at a time, for round-trip time.
+static void bench_rtt(hid_device *handle, int count)
+{
+	unsigned char out[REPORT_LEN + 1], in[REPORT_LEN];
+	double *rtt = (double *)malloc(count * sizeof(double));
+	double t;
+	int i, res, done = 0, lost = 0, wrong = 0;
+
+	for (i = 0; i < count; i++) {
+		memset(out, 0, sizeof(out));
+		out[0] = REPORT_NUMBER;
+		out[1] = 0x82;
+		out[2] = i & 0xff;
+		out[3] = i >> 8;
+		t = now_us();
+		if (hid_write(handle, out, sizeof(out)) < 0) {
+			printf("Unable to write() (echo)\n");
+			break;
+		}
+		res = hid_read_timeout(handle, in, sizeof(in), BENCH_TIMEOUT_MS);
+		if (res <= 0) {
+			lost++;
+			continue;
+		}
+		rtt[done++] = now_us() - t;
+		if (in[0] != 0x82 || in[1] != (i & 0xff) || in[2] != (i >> 8))
+			wrong++;
+	}
+
+	printf("\necho: %d reports, %d lost, %d out of sequence\n", count, lost, wrong);
+	print_percentiles("rtt us", rtt, done);
+	free(rtt);
+}
+
+// Command 0x83: the device streams numbered, frame-stamped IN reports.
+static void bench_in(hid_device *handle, int count)
+{
+	unsigned char out[REPORT_LEN + 1], in[REPORT_LEN];
+	unsigned short seq, expected = 0, frame, last_frame = 0;
+	int i, res, received = 0, dropped = 0, reordered = 0, same_frame = 0, skipped_frames = 0;
+	double t0 = 0, t1 = 0;
+
+	memset(out, 0, sizeof(out));
+	out[0] = REPORT_NUMBER;
+	out[1] = 0x83;
+	out[2] = count & 0xff;
+	out[3] = count >> 8;
+	if (hid_write(handle, out, sizeof(out)) < 0) {
+		printf("Unable to write() (stream)\n");
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		res = hid_read_timeout(handle, in, sizeof(in), BENCH_TIMEOUT_MS);
+		if (res <= 0)
+			break;
+		if (in[0] != 0x83)
+			continue;
+		t1 = now_us();
+		if (!received)
+			t0 = t1;
+		seq = in[1] | in[2] << 8;
+		frame = (in[3] | in[4] << 8) & 0x7ff;
+		if (received) {
+			// the frame number is 11 bits
+			unsigned short frames = (frame - last_frame) & 0x7ff;
+			if (frames == 0)
+				same_frame++;
+			else if (frames > 1)
+				skipped_frames += frames - 1;
+		}
+		last_frame = frame;
+		if (seq < expected)
+			reordered++;
+		else
+			dropped += seq - expected;
+		expected = seq + 1;
+		received++;
+	}
+	dropped += count - expected > 0 ? count - expected : 0;
+
+	printf("\nIN stream: %d reports asked for, %d received, %d dropped, %d out of order\n",
+	       count, received, dropped, reordered);
+	if (received > 1)
+		printf("IN stream: %.1f reports/s, %.1f kB/s; %d frames without a report, %d reports sharing a frame\n",
+		       (received - 1) * 1e6 / (t1 - t0),
+		       (received - 1) * REPORT_LEN * 1e3 / (t1 - t0),
+		       skipped_frames, same_frame);
+
+	// stop the stream, in case it hasn't finished
+	out[2] = out[3] = 0;
+	hid_write(handle, out, sizeof(out));
+}
+
+// Command 0x84: the device only counts what it gets; 0x85 says how much.
+static void bench_out(hid_device *handle, int count)
+{
+	unsigned char out[REPORT_LEN + 1], in[REPORT_LEN];
+	int i, res;
+	double t0, t1;
+
+	// clear the device's sink counters
+	memset(out, 0, sizeof(out));
+	out[0] = REPORT_NUMBER;
+	out[1] = 0x85;
+	hid_write(handle, out, sizeof(out));
+	read_reply(handle, in, 0x85);
+
+	t0 = now_us();
+	for (i = 0; i < count; i++) {
+		out[1] = 0x84;
+		out[2] = i & 0xff;
+		out[3] = i >> 8;
+		if (hid_write(handle, out, sizeof(out)) < 0) {
+			printf("Unable to write() (sink)\n");
+			break;
+		}
+	}
+
+	out[1] = 0x85;
+	hid_write(handle, out, sizeof(out));
+	res = read_reply(handle, in, 0x85);
+	t1 = now_us();
+	if (res <= 0) {
+		printf("\nOUT sink: no status from the device\n");
+		return;
+	}
+
+	printf("\nOUT sink: %d reports sent, %d counted, %d out of sequence\n",
+	       i, in[1] | in[2] << 8, in[3] | in[4] << 8);
+	printf("OUT sink: %.1f reports/s, %.1f kB/s\n",
+	       i * 1e6 / (t1 - t0), i * REPORT_LEN * 1e3 / (t1 - t0));
+}
+
+// The same sequence of small commands (alternately 0x80 and 0x81) sent one
+// report each, then as one batch (0x86).
+#define BATCH_COMMANDS 20
+
+static void bench_batch(hid_device *handle, int count)
+{
+	unsigned char out[REPORT_LEN + 1], in[REPORT_LEN];
+	double t, single = 0, batched = 0;
+	int i, j, p, failed = 0;
+
+	for (i = 0; i < count; i++) {
+		t = now_us();
+		for (j = 0; j < BATCH_COMMANDS; j++) {
+			memset(out, 0, sizeof(out));
+			out[0] = REPORT_NUMBER;
+			out[1] = j & 1 ? 0x81 : 0x80;
+			hid_write(handle, out, sizeof(out));
+			if ((j & 1) && read_reply(handle, in, 0x81) <= 0)
+				failed++;
+		}
+		single += now_us() - t;
+
+		memset(out, 0, sizeof(out));
+		out[0] = REPORT_NUMBER;
+		out[1] = 0x86;
+		for (j = 0, p = 2; j < BATCH_COMMANDS; j++) {
+			out[p++] = j & 1 ? 0x81 : 0x80;
+			out[p++] = 0;
+		}
+		t = now_us();
+		hid_write(handle, out, sizeof(out));
+		if (read_reply(handle, in, 0x86) <= 0 || in[1] != BATCH_COMMANDS)
+			failed++;
+		batched += now_us() - t;
+	}
+
+	printf("\n%d commands: %.0f us as single reports, %.0f us as one batch; %d failures\n",
+	       BATCH_COMMANDS, single / count, batched / count, failed);
+}
+
+// hidtest bench [count]: a baseline for the 1ms interrupt endpoints
+static void benchmark(hid_device *handle, int count)
+{
+	unsigned char buf[REPORT_LEN];
+
+	// the reads below wait, and nothing from the demo above should be left over
+	hid_set_nonblocking(handle, 0);
+	while (hid_read_timeout(handle, buf, sizeof(buf), 100) > 0)
+		;
+
+	// sequence numbers are 16 bits
+	if (count < 1 || count > 65535)
+		count = 1000;
+
+	bench_rtt(handle, count);
+	bench_in(handle, count);
+	bench_out(handle, count);
+	bench_batch(handle, count / 10 + 1);
+}
+
 int main(int argc, char* argv[])
 {
 	int res;
@@ -38,11 +282,6 @@ int main(int argc, char* argv[])
 	hid_device *handle;
 	int i;
 
-#ifdef WIN32
-	UNREFERENCED_PARAMETER(argc);
-	UNREFERENCED_PARAMETER(argv);
-#endif
-
 	struct hid_device_info *devs, *cur_dev;
 	
 	if (hid_init())
@@ -183,6 +422,9 @@ int main(int argc, char* argv[])
 		printf("%02hhx ", buf[i]);
 	printf("\n");
 
+	if (argc > 1 && !strcmp(argv[1], "bench"))
+		benchmark(handle, argc > 2 ? atoi(argv[2]) : 1000);
+
 	hid_close(handle);
 
 	/* Free static HIDAPI objects. */
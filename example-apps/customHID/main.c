@@ -30,16 +30,60 @@
 #include "usb_config.h"
 #include "usb_ch9.h"
 #include "usb_hid.h"
+#include "reboot_request.h"
 
 /* 
 since this is a downloaded app, configuration words (e.g. __CONFIG or #pragma config) are not relevant
 */
 
+/* what the commands below work on */
+static uint8_t counter;
+
+/* command 0x83: IN reports still to send, and the next one's sequence number */
+static uint16_t stream_left;
+static uint16_t stream_seq;
+
+/* command 0x84: OUT reports counted, and those not numbered one more than the last */
+static uint16_t sink_count;
+static uint16_t sink_errors;
+static uint16_t sink_expected;
+
+/*
+command 0x87: the ADC is sampled on each Timer2 period match, from the interrupt, into one of two blocks
+while one block fills, the other (once full) waits for the main loop to copy it into an IN report
+Timer2 runs from Fosc/4 (12MHz) with a 1:4 prescale, so a period of 108 gives 27778 samples/s
+which is 992 blocks of 28 samples a second, just under the one report per frame the host polls for
+*/
+#define SAMPLE_PR2 107
+#define SAMPLES_PER_BLOCK ((EP_1_IN_LEN - 8) / 2)
+
+struct sample_block {
+	uint16_t seq;		/* blocks started since sampling began, so a gap shows blocks lost */
+	uint16_t frame;		/* 11-bit number of the frame the first sample was taken in */
+	uint16_t samples[SAMPLES_PER_BLOCK];
+};
+
+static struct sample_block sample_blocks[2];
+static volatile uint8_t sample_full[2];	/* set by the ISR, cleared by the main loop once the block is sent */
+static uint8_t sample_fill;		/* ISR: block being filled, and how many samples it holds */
+static uint8_t sample_count;
+static uint16_t sample_seq;
+static uint8_t sample_send;		/* main loop: block to send next */
+static uint16_t sample_left;		/* reports still to send; 0xFFFF keeps sampling until stopped */
+static uint8_t sample_channel;
+
+static void sampling_stop(void);
+
+/* unknown command, missing argument bytes, or no room for the reply */
+#define COMMAND_FAILED -1
+
+static int8_t command(uint8_t cmd, const uint8_t *arg, uint8_t arg_len, uint8_t *reply, uint8_t room);
+static void batch(const uint8_t *in, uint8_t *out);
+
 int main(void)
 {
 	uint8_t *TxDataBuffer;
 	const uint8_t *RxDataBuffer;
-	uint8_t counter = 0;
 
 #ifdef USB_USE_INTERRUPTS
 	INTCONbits.PEIE = 1;
@@ -48,8 +92,6 @@ int main(void)
 
 	usb_init();
 
-	TxDataBuffer = usb_get_in_buffer(1);
-
 	for (;;)
 	{
 #ifndef USB_USE_INTERRUPTS
@@ -67,9 +109,57 @@ int main(void)
 		if (usb_in_endpoint_halted(1) || usb_in_endpoint_busy(1))
 			continue;
 
+		/* with EP1 ping-ponged, each IN report goes in whichever of its two buffers is the CPU's turn */
+		TxDataBuffer = usb_get_in_buffer(1);
+
 		/* if we pass this test, we are committed to make the usb_arm_out_endpoint() call */
 		if (!usb_out_endpoint_has_data(1))
+		{
+			/*
+			with no command waiting, a stream started by command 0x83 gets the IN endpoint
+			the host polls it once per 1ms frame, so that is the rate the reports go out at
+			*/
+			if (stream_left)
+			{
+				uint8_t h;
+
+				TxDataBuffer[0] = 0x83;
+				TxDataBuffer[1] = stream_seq & 0xFF;
+				TxDataBuffer[2] = stream_seq >> 8;
+				/* timestamp: the 11-bit number of the frame the report was queued in (read as in sample_isr()) */
+				do
+				{
+					h = UFRMH;
+					TxDataBuffer[3] = UFRML;
+				} while (h != UFRMH);
+				TxDataBuffer[4] = h;
+				usb_send_in_buffer(1, EP_1_IN_LEN);
+				stream_seq++;
+				stream_left--;
+			}
+			else if (sample_left && sample_full[sample_send])
+			{
+				struct sample_block *b = &sample_blocks[sample_send];
+
+				TxDataBuffer[0] = 0x87;
+				TxDataBuffer[1] = b->seq & 0xFF;
+				TxDataBuffer[2] = b->seq >> 8;
+				TxDataBuffer[3] = b->frame & 0xFF;
+				TxDataBuffer[4] = b->frame >> 8;
+				TxDataBuffer[5] = sample_channel;
+				TxDataBuffer[6] = SAMPLES_PER_BLOCK;
+				TxDataBuffer[7] = 0;
+				memcpy(TxDataBuffer + 8, b->samples, sizeof(b->samples));
+				usb_send_in_buffer(1, EP_1_IN_LEN);
+
+				/* the block is ours again; with ping-pong the next report can be queued while this one goes out */
+				sample_full[sample_send] = 0;
+				sample_send ^= 1;
+				if (sample_left != 0xFFFF && --sample_left == 0)
+					sampling_stop();
+			}
 			continue;
+		}
 
 		/* obtain a pointer to the receive buffer and the length of data contained within it */
 		usb_get_out_buffer(1, &RxDataBuffer);
@@ -77,41 +167,229 @@ int main(void)
 		/* pre-fill the response with an echo back of the command */
 		TxDataBuffer[0] = RxDataBuffer[0];
 
+		if (RxDataBuffer[0] == 0x86)
+		{
+			/* a batch is always answered, if only to say how many of its commands were carried out */
+			batch(RxDataBuffer, TxDataBuffer);
+			usb_send_in_buffer(1, EP_1_IN_LEN);
+		}
+		else if (command(RxDataBuffer[0], RxDataBuffer + 1, EP_1_OUT_LEN - 1, TxDataBuffer + 1, EP_1_IN_LEN - 1) > 0)
+		{
+			/* send a response back to the PC */
+			usb_send_in_buffer(1, EP_1_IN_LEN);
+		}
+
+		/* re-arm the endpoint to receive the next EP1 OUT */
+		usb_arm_out_endpoint(1);
+	}
+}
+
+/*
+carry out one command, given either as a whole report or as one entry of a batch (command 0x86)
+arg points at the arg_len bytes following the command code; any reply is written to reply, which has room for room bytes
+returns the length of the reply (0 if there is none), or COMMAND_FAILED having done nothing
+*/
+static int8_t command(uint8_t cmd, const uint8_t *arg, uint8_t arg_len, uint8_t *reply, uint8_t room)
+{
+	uint16_t seq;
+
+	/*
+	note to would-be developer: be VERY WARY about using a switch() statement
+	the XC8 compiler generates bloated code, particularly if the case values are not all consecutive
+	if, else if, else if statements are more efficient with XC8, albeit at the cost of readability
+	*/
+	switch (cmd)
+	{
+
+	case 0x80:
+
+		/*
+		action in response to command would go here
+		as an example, we are incrementing a counter than can be read by command 0x81
+		*/
+		counter++;
+
+		return 0;
+
+	case 0x81:
+
+		/*
+		response to query command would go here
+		as an example, we are returning the counter value incremented by command 0x80
+		*/
+		if (room < 1)
+			return COMMAND_FAILED;
+		reply[0] = counter;
+
+		return 1;
+
+	case 0x82:
+
+		/* echo: the arguments come straight back (the whole report, on its own), for round-trip timing */
+		if (room < arg_len)
+			return COMMAND_FAILED;
+		memcpy(reply, arg, arg_len);
+
+		return arg_len;
+
+	case 0x83:
+
 		/*
-		note to would-be developer: be VERY WARY about using a switch() statement
-		the XC8 compiler generates bloated code, particularly if the case values are not all consecutive
-		if, else if, else if statements are more efficient with XC8, albeit at the cost of readability
+		stream: bytes 1-2 (little-endian) give the number of IN reports to send, one per frame; 0 stops a stream
+		each report carries its sequence number (from 0) in bytes 1-2 and the frame number in bytes 3-4
 		*/
-		switch (RxDataBuffer[0])
+		if (arg_len < 2)
+			return COMMAND_FAILED;
+		stream_left = arg[0] | (uint16_t)arg[1] << 8;
+		stream_seq = 0;
+
+		return 0;
+
+	case 0x84:
+
+		/* sink: bytes 1-2 carry a sequence number; the report is only counted, for OUT throughput */
+		if (arg_len < 2)
+			return COMMAND_FAILED;
+		seq = arg[0] | (uint16_t)arg[1] << 8;
+		if (seq != sink_expected)
+			sink_errors++;
+		sink_expected = seq + 1;
+		sink_count++;
+
+		return 0;
+
+	case 0x85:
+
+		/* sink status: reports counted (bytes 1-2) and sequence errors (bytes 3-4) since the last 0x85 */
+		if (room < 4)
+			return COMMAND_FAILED;
+		reply[0] = sink_count & 0xFF;
+		reply[1] = sink_count >> 8;
+		reply[2] = sink_errors & 0xFF;
+		reply[3] = sink_errors >> 8;
+		sink_count = 0;
+		sink_errors = 0;
+		sink_expected = 0;
+
+		return 4;
+
+	case 0x87:
+
+		/*
+		sample: byte 1 is the ADC channel (AN3 to AN7), bytes 2-3 the number of reports to send; 0 stops sampling and 0xFFFF never stops
+		each report carries the block sequence number in bytes 1-2, the frame number of its first sample in bytes 3-4,
+		the channel in byte 5, the number of samples in byte 6, then from byte 8 the 10-bit samples (little-endian, right-justified)
+		*/
+		if (arg_len < 3 || arg[0] < 3 || arg[0] > 7)
+			return COMMAND_FAILED;
+		sampling_stop();
+		sample_left = arg[1] | (uint16_t)arg[2] << 8;
+		if (!sample_left)
+			return 0;
+
+		if (arg[0] == 3)
+		{
+			/* AN3 is on RA4 */
+			TRISA |= 0x10;
+			ANSELA |= 0x10;
+		}
+		else
 		{
+			/* AN4 to AN7 are on RC0 to RC3 */
+			TRISC |= 1 << (arg[0] - 4);
+			ANSELC |= 1 << (arg[0] - 4);
+		}
 
-		case 0x80:
+		sample_channel = arg[0];
+		sample_full[0] = sample_full[1] = 0;
+		sample_fill = sample_send = 0;
+		sample_count = 0;
+		sample_seq = 0;
 
-			/*
-			action in response to command would go here
-			as an example, we are incrementing a counter than can be read by command 0x81
-			*/
-			counter++;
+		/* right-justified result, Fosc/64 conversion clock (1.33us TAD), VDD reference; the first conversion is started here */
+		ADCON1 = 0xE0;
+		ADCON0 = sample_channel << 2 | 0x01;
+		ADCON0bits.GO_nDONE = 1;
 
-			break;
+		PR2 = SAMPLE_PR2;
+		TMR2 = 0;
+		PIR1bits.TMR2IF = 0;
+		PIE1bits.TMR2IE = 1;
+		INTCONbits.PEIE = 1;
+		INTCONbits.GIE = 1;
+		/* 1:4 prescale, 1:1 postscale, on */
+		T2CON = 0x05;
 
-		case 0x81:
+		return 0;
 
-			/*
-			response to query command would go here
-			as an example, we are returning the counter value incremented by command 0x80
-			*/
-			TxDataBuffer[1] = counter;
+	}
 
-			/* send a response back to the PC */
-			usb_send_in_buffer(1, EP_1_IN_LEN);
+	return COMMAND_FAILED;
+}
+
+/*
+command 0x86: several commands in one report, so that a sequence of small ones costs one frame rather than one each
+from byte 1, each command is its code, the number of argument bytes and those bytes, up to a code of 0 or the end of the report
+they are carried out in order, stopping at the first that fails (a batch can't hold another batch)
+the reply gives the number carried out in byte 1, then for each of them its code, the length of its reply, and the reply
+*/
+static void batch(const uint8_t *in, uint8_t *out)
+{
+	uint8_t i = 1, o = 2, done = 0, len;
+	int8_t res;
 
+	while (i + 2 <= EP_1_OUT_LEN && in[i] != 0)
+	{
+		len = in[i + 1];
+		if (i + 2 + len > EP_1_OUT_LEN || o + 2 > EP_1_IN_LEN)
+			break;
+		res = command(in[i], in + i + 2, len, out + o + 2, EP_1_IN_LEN - o - 2);
+		if (res < 0)
 			break;
+		out[o] = in[i];
+		out[o + 1] = res;
+		o += 2 + res;
+		i += 2 + len;
+		done++;
+	}
+	out[1] = done;
+}
 
-		}
+static void sampling_stop(void)
+{
+	PIE1bits.TMR2IE = 0;
+	T2CON = 0;
+	ADCON0 = 0;
+}
 
-		/* re-arm the endpoint to receive the next EP1 OUT */
-		usb_arm_out_endpoint(1);
+/* called on each Timer2 match while sampling: take the last conversion and start the next */
+static void sample_isr(void)
+{
+	struct sample_block *b = &sample_blocks[sample_fill];
+	uint8_t h;
+
+	b->samples[sample_count] = ADRES;
+	ADCON0bits.GO_nDONE = 1;
+
+	if (sample_count == 0)
+	{
+		b->seq = sample_seq++;
+		/* UFRMH is read either side of UFRML, in case the frame number rolls over in between */
+		do {
+			h = UFRMH;
+			b->frame = UFRML | (uint16_t)h << 8;
+		} while (h != UFRMH);
+	}
+
+	if (++sample_count < SAMPLES_PER_BLOCK)
+		return;
+	sample_count = 0;
+
+	/* if the host hasn't taken the other block yet, this one is dropped and refilled (its sequence number is skipped) */
+	if (!sample_full[sample_fill ^ 1])
+	{
+		sample_full[sample_fill] = 1;
+		sample_fill ^= 1;
 	}
 }
 
@@ -129,8 +407,23 @@ int8_t app_unknown_setup_request_callback(const struct setup_packet *setup)
 	return process_hid_setup_request(setup);
 }
 
+/* HID Callbacks. See usb_hid.h for documentation. */
+
+int8_t app_set_report_callback(uint8_t interface, uint8_t report_type,
+                               uint8_t report_id)
+{
+	/* the Output report arrives on EP1 OUT instead, which leaves the reboot request */
+	return reboot_request_set_report(report_type);
+}
+
 void interrupt isr()
 {
+	if (PIE1bits.TMR2IE && PIR1bits.TMR2IF)
+	{
+		PIR1bits.TMR2IF = 0;
+		sample_isr();
+	}
+
 #ifdef USB_USE_INTERRUPTS
     usb_service();
 #endif
@@ -0,0 +1,53 @@
+/*
+    reboot into the bootloader when the host asks; see reboot_request.h
+
+    the same file is in each HID example app
+*/
+
+#include <xc.h>
+#include <stdint.h>
+#include "usb.h"
+#include "usb_config.h"
+#include "usb_hid.h"
+#include "reboot_request.h"
+
+#ifdef REBOOT_INTERFACE
+const uint8_t reboot_report_descriptor[REBOOT_REPORT_DESCRIPTOR_LEN] =
+{
+	0x06, 0x00, 0xFF,              // USAGE_PAGE (Vendor Defined Page 1)
+	0x09, 0x01,                    // USAGE (Vendor Usage 1)
+	0xA1, 0x01,                    // COLLECTION (Application)
+	0x09, 0x01,                    //   USAGE (Vendor Usage 1)
+	0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
+	0x26, 0xFF, 0x00,              //   LOGICAL_MAXIMUM (255)
+	0x75, 0x08,                    //   REPORT_SIZE (8)
+	0x95, 0x01,                    //   REPORT_COUNT (1)
+	0xB1, 0x02,                    //   FEATURE (Data,Var,Abs)
+	0xC0                           // END_COLLECTION
+};
+#endif
+
+static uint8_t feature_buf[1];
+
+static void feature_callback(bool transfer_ok, void *context)
+{
+	if (transfer_ok && (REBOOT_REQUEST == feature_buf[0]))
+	{
+		/*
+		enable the watchdog with a 32ms period, time enough for the status stage to complete;
+		the code doesn't clear the watchdog, so it resets
+		*/
+		WDTCONbits.WDTPS = 0b00101;
+		WDTCONbits.SWDTEN = 1;
+	}
+}
+
+int8_t reboot_request_set_report(uint8_t report_type)
+{
+	if (HID_FEATURE != report_type)
+		return -1;
+
+	usb_start_receive_ep0_data_stage(feature_buf, sizeof(feature_buf), &feature_callback, NULL);
+
+	return 0;
+}
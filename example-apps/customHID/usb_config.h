@@ -53,13 +53,18 @@
 	PPB_EPN_ONLY     - Ping-pong all endpoints except 0
 */
 
-#define PPB_MODE PPB_NONE
+/* EP1 is ping-ponged so that command 0x87 can queue one sample report while the last one goes out */
+#define PPB_MODE PPB_EPN_ONLY
 
 /* Comment the following line to use polling USB operation. When using polling,
    You are responsible for calling usb_service() periodically from your
    application. */
 //#define USB_USE_INTERRUPTS
 
+/* Handle up to this many completed transactions per usb_service() call
+   instead of one; the USTAT FIFO holds four. */
+#define USB_MAX_TOKENS_PER_SERVICE 4
+
 /* Objects from usb_descriptors.c */
 #define USB_DEVICE_DESCRIPTOR this_device_descriptor
 #define USB_CONFIG_DESCRIPTOR_MAP usb_application_config_descs
@@ -87,7 +92,7 @@
 
 /* HID Callbacks. See usb_hid.h for documentation. */
 //#define HID_GET_REPORT_CALLBACK app_get_report_callback
-//#define HID_SET_REPORT_CALLBACK app_set_report_callback
+#define HID_SET_REPORT_CALLBACK app_set_report_callback
 //#define HID_GET_IDLE_CALLBACK app_get_idle_callback
 //#define HID_SET_IDLE_CALLBACK app_set_idle_callback
 //#define HID_GET_PROTOCOL_CALLBACK app_get_protocol_callback
@@ -81,6 +81,11 @@ static const ROMPTR uint8_t custom_report_descriptor[] =
     0x19, 0x01,             //      Usage Minimum 
     0x29, 0x40,             //      Usage Maximum 	//64 output usages total (0x01 to 0x40)
     0x91, 0x00,             //      Output (Data, Array, Abs): Instantiates output packet fields.  Uses same report size and count as "Input" fields, since nothing new/different was specified to the parser since the "Input" item.
+    0x09, 0x41,             //      Usage (Vendor Usage 0x41)
+    0x15, 0x00,             //      Logical Minimum (0)
+    0x26, 0xFF, 0x00,       //      Logical Maximum (255)
+    0x95, 0x01,             //      Report Count: one 8-bit field
+    0xB1, 0x02,             //      Feature (Data, Var, Abs): reboot request, see reboot_request.h
     0xC0                    // End Collection
 };
 
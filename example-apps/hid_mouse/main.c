@@ -26,6 +26,8 @@
 #include "usb_config.h"
 #include "usb_ch9.h"
 #include "usb_hid.h"
+#include "sof_timer.h"
+#include "reboot_request.h"
 
 /*
  the reference code from Signal 11 has a bevy of #pragma config options
@@ -33,9 +35,38 @@
  */
 
 #ifdef MULTI_CLASS_DEVICE
-static uint8_t hid_interfaces[] = { 0 };
+static uint8_t hid_interfaces[] = { 0, REBOOT_INTERFACE };
 #endif
 
+/* timers on the start-of-frame wheel; see sof_timer.h */
+#define REPORT_TIMER 0
+
+/* The path the pointer follows: each segment moves it dx, dy pixels,
+ * spread evenly over the given number of 1ms frames. */
+struct path_segment {
+	int8_t dx;
+	int8_t dy;
+	uint16_t frames;
+};
+
+static const struct path_segment path[] = {
+	{ 100, 0, 700 },
+	{ -100, 0, 700 },
+};
+
+#define PATH_LEN (sizeof(path) / sizeof(path[0]))
+
+static uint8_t segment;
+static uint16_t segment_frame;
+
+/* Sub-pixel motion carried between frames, in 1/frames of a pixel. */
+static uint16_t x_fraction, y_fraction;
+
+/* Motion made but not yet sent, if the host missed a report. */
+static int16_t x_pending, y_pending;
+
+static void report_task(void);
+
 int main(void)
 {
 /*
@@ -60,42 +91,17 @@ int main(void)
 #endif
 	usb_init();
 
-	/* Setup mouse movement. This implementation sends back data for every
-	 * IN packet, but sends no movement for all but every delay-th frame.
-	 * Adjusting delay will slow down or speed up the movement, which is
-	 * also dependent upon the rate at which the host sends IN packets,
-	 * which varies between implementations.
-	 *
-	 * In real life, you wouldn't want to send back data that hadn't
-	 * changed, but since there's no real hardware to poll, and since this
-	 * example is about showing the HID class, and not about creative ways
-	 * to do timing, we send back data every frame. The interested reader
-	 * may want to modify it to use the start-of-frame callback for
-	 * timing.
+	/* Setup mouse movement. The report engine runs once per frame,
+	 * from the start-of-frame timer wheel, and makes exactly one report
+	 * a frame, moving the pointer along the path a frame's worth at a
+	 * time. The speed of the movement is therefore the same whatever
+	 * rate the host sends IN packets at.
 	 */
-	uint8_t x_count = 100;
-	uint8_t delay = 7;
-	int8_t x_direc = 1;
+	sof_timer_start(REPORT_TIMER, report_task, 1, 1);
 
 	while (1) {
-		if (usb_is_configured() &&
-		    !usb_in_endpoint_halted(1) &&
-		    !usb_in_endpoint_busy(1)) {
-
-			unsigned char *buf = usb_get_in_buffer(1);
-			buf[0] = 0x0;
-			buf[1] = (--delay)? 0: x_direc;
-			buf[2] = 0;
-			usb_send_in_buffer(1, 3);
-
-			if (delay == 0) {
-				if (--x_count == 0) {
-					x_count = 100;
-					x_direc *= -1;
-				}
-				delay = 7;
-			}
-		}
+		if (usb_is_configured())
+			sof_timer_run();
 
 		#ifndef USB_USE_INTERRUPTS
 		usb_service();
@@ -105,6 +111,69 @@ int main(void)
 	return 0;
 }
 
+/* Whole pixels to move this frame, of a move of d pixels over frames
+ * frames. fraction carries the part of a pixel left over from one frame
+ * to the next (Bresenham's line algorithm), so the move comes to
+ * exactly d. */
+static int8_t interpolate(int8_t d, uint16_t frames, uint16_t *fraction)
+{
+	uint16_t sum = *fraction + (uint8_t)(d < 0? -d: d);
+	uint8_t n = 0;
+
+	while (sum >= frames) {
+		sum -= frames;
+		n++;
+	}
+	*fraction = sum;
+
+	return d < 0? -(int8_t)n: (int8_t)n;
+}
+
+static int8_t clamp(int16_t v)
+{
+	if (v > 127)
+		return 127;
+	if (v < -127)
+		return -127;
+	return v;
+}
+
+static void report_task(void)
+{
+	const struct path_segment *seg = &path[segment];
+	unsigned char *buf;
+	int8_t x, y;
+
+	/* Start each segment half a pixel in, to round to the nearest frame. */
+	if (segment_frame == 0)
+		x_fraction = y_fraction = seg->frames / 2;
+
+	x_pending += interpolate(seg->dx, seg->frames, &x_fraction);
+	y_pending += interpolate(seg->dy, seg->frames, &y_fraction);
+
+	if (++segment_frame == seg->frames) {
+		segment_frame = 0;
+		if (++segment == PATH_LEN)
+			segment = 0;
+	}
+
+	/* If the last report is still waiting for the host, this frame's
+	 * motion goes in the next one instead. */
+	if (usb_in_endpoint_halted(1) || usb_in_endpoint_busy(1))
+		return;
+
+	x = clamp(x_pending);
+	y = clamp(y_pending);
+	x_pending -= x;
+	y_pending -= y;
+
+	buf = usb_get_in_buffer(1);
+	buf[0] = 0x0;
+	buf[1] = x;
+	buf[2] = y;
+	usb_send_in_buffer(1, 3);
+}
+
 /* Callbacks. These function names are set in usb_config.h. */
 void app_set_configuration_callback(uint8_t configuration)
 {
@@ -161,7 +230,7 @@ int16_t app_unknown_get_descriptor_callback(const struct setup_packet *pkt, cons
 
 void app_start_of_frame_callback(void)
 {
-
+	sof_timer_tick();
 }
 
 void app_usb_reset_callback(void)
@@ -204,8 +273,11 @@ int8_t app_set_report_callback(uint8_t interface, uint8_t report_type,
 {
 	/* To handle Set_Report, call usb_start_receive_ep0_data_stage()
 	 * here. See the documentation for HID_SET_REPORT_CALLBACK() in
-	 * usb_hid.h. For this device though, there are no output or
-	 * feature reports. */
+	 * usb_hid.h. The only report the host can set on this device is
+	 * the reboot request, on its own interface. */
+	if (REBOOT_INTERFACE == interface)
+		return reboot_request_set_report(report_type);
+
 	return -1;
 }
 
@@ -0,0 +1,55 @@
+/*
+    timer wheel clocked by the USB SOF (Start Of Frame), one tick per 1ms frame
+
+    the same file is in each example app that uses it
+*/
+
+#ifndef SOF_TIMER_H__
+#define SOF_TIMER_H__
+
+#include <stdint.h>
+
+/*
+app_start_of_frame_callback() calls sof_timer_tick(), which only counts the frame
+the main loop calls sof_timer_run() once per pass (next to usb_service()); each call moves the wheel
+on by at most one frame and runs at most SOF_TIMER_DISPATCH due tasks, so it never holds up the loop for long
+tasks run from the main loop, never from the interrupt, and may start or stop any timer (their own included)
+
+a periodic task is rescheduled from the frame it fell due in, not from when it got to run,
+so a late run doesn't push the ones after it back
+*/
+
+/* timers are numbered 0 to SOF_TIMERS - 1 by the app; when several are due, the lower number runs first */
+#ifndef SOF_TIMERS
+#define SOF_TIMERS 4
+#endif
+
+/* slots in the wheel (a power of 2); a timer further off than this goes round it more than once */
+#ifndef SOF_TIMER_SLOTS
+#define SOF_TIMER_SLOTS 8
+#endif
+
+/* tasks run per sof_timer_run() call; any more that are due wait for the next call */
+#ifndef SOF_TIMER_DISPATCH
+#define SOF_TIMER_DISPATCH 2
+#endif
+
+/*
+start (or restart) timer id: fn runs delay frames from now (a delay of 0 counts as 1)
+and then, if period isn't 0, every period frames after that
+*/
+void sof_timer_start(uint8_t id, void (*fn)(void), uint16_t delay, uint16_t period);
+
+/* stop timer id; if it was due but hadn't run yet, it doesn't */
+void sof_timer_stop(uint8_t id);
+
+/* call from app_start_of_frame_callback() */
+void sof_timer_tick(void);
+
+/* call from the main loop */
+void sof_timer_run(void);
+
+/* number of times a periodic task fell due again before it had run; cleared by reading */
+uint8_t sof_timer_overruns(void);
+
+#endif /* SOF_TIMER_H__ */
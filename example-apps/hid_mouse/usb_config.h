@@ -28,13 +28,15 @@
    BOTH IN and OUT endpoints for endpoint numbers (besides zero) up to the
    value specified.  For example, setting NUM_ENDPOINT_NUMBERS to 2 will
    activate endpoints EP 1 IN, EP 1 OUT, EP 2 IN, EP 2 OUT.  */
-#define NUM_ENDPOINT_NUMBERS 1
+#define NUM_ENDPOINT_NUMBERS 2
 
 /* Only 8, 16, 32 and 64 are supported for endpoint zero length. */
 #define EP_0_LEN 8
 
 #define EP_1_OUT_LEN 8
 #define EP_1_IN_LEN 8
+#define EP_2_OUT_LEN 1
+#define EP_2_IN_LEN 1 /* reboot interface; never armed */
 
 #define NUMBER_OF_CONFIGURATIONS 1
 
@@ -56,6 +58,10 @@
    application. */
 #define USB_USE_INTERRUPTS
 
+/* Handle up to this many completed transactions per usb_service() call
+   instead of one; the USTAT FIFO holds four. */
+//#define USB_MAX_TOKENS_PER_SERVICE 4
+
 /* Uncomment if you have a composite device which has multiple different types
  * of device classes. For example a device which has HID+CDC or
  * HID+VendorDefined, but not a device which has multiple of the same class
@@ -90,6 +96,9 @@
 #define USB_HID_REPORT_DESCRIPTOR_FUNC usb_application_get_hid_report_descriptor
 //#define USB_HID_PHYSICAL_DESCRIPTOR_FUNC usb_application_get_hid_physical_descriptor
 
+/* Interface that carries the reboot request. See reboot_request.h. */
+#define REBOOT_INTERFACE 1
+
 /* HID Callbacks. See usb_hid.h for documentation. */
 #define HID_GET_REPORT_CALLBACK app_get_report_callback
 #define HID_SET_REPORT_CALLBACK app_set_report_callback
@@ -0,0 +1,467 @@
+/*
+    throughput and latency benchmark for the minimalCDC USB-serial bridge
+    (Linux)
+
+    With one port, the board's TX (RC4) is jumpered to its RX (RC5), so
+    everything written to the tty comes back; with two ports, two bridges
+    (or a bridge and any other adapter) are cross-wired.  Three tests run:
+
+      stream  A->B for a while, as fast as the ports will take it
+      duplex  A->B and B->A at once (two ports only)
+      rtt     small messages sent one at a time and echoed back (by the
+              jumper, or by this program on port B)
+
+    The streams carry a position-derived pattern, so loss and corruption
+    are both caught; throughput is measured at the receiver, from its first
+    byte to its last.
+
+    -L 1 or -L 2 replaces the ttys with pseudo-terminals served by a
+    stand-in for the hardware: it moves bytes at the line rate, in packets
+    of up to 64 bytes held for up to 2ms, as the bridge does.  That is
+    enough to check this program without a board.
+
+    usage: cdcbench [-b baud] [-t seconds] [-n messages] [-s size] tty [tty]
+           cdcbench [-b baud] [-t seconds] [-n messages] [-s size] -L ports
+
+    The exit status is non-zero if any data was lost or corrupted.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* a receiver gives up once nothing has arrived for this long after its
+   writer has finished */
+#define DRAIN_MS 500
+/* an rtt message that has not come back by then is counted lost */
+#define RTT_TIMEOUT_MS 1000
+
+/* what the stand-in imitates: EP_2_IN_LEN and IN_COALESCE_FRAMES */
+#define STANDIN_PACKET 64
+#define STANDIN_HOLD_NS 2000000
+
+struct stream {
+	const char *name;
+	int tx_fd, rx_fd;
+	double seconds;
+	volatile int writing;
+	uint64_t sent, received, mismatched;
+	uint64_t first_ns, last_ns;
+};
+
+struct standin {
+	int in, out;
+	unsigned long baud;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t)
+{
+	struct timespec ts;
+
+	ts.tv_sec = t / 1000000000;
+	ts.tv_nsec = t % 1000000000;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(2);
+}
+
+/* the byte at a given offset of a stream */
+static uint8_t pattern(uint64_t offset)
+{
+	return offset ^ offset >> 8 ^ offset >> 16;
+}
+
+static const struct {
+	unsigned long baud;
+	speed_t speed;
+} speeds[] = {
+	{ 300, B300 }, { 1200, B1200 }, { 2400, B2400 }, { 4800, B4800 },
+	{ 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 },
+	{ 57600, B57600 }, { 115200, B115200 }, { 230400, B230400 },
+	{ 460800, B460800 }, { 500000, B500000 }, { 576000, B576000 },
+	{ 921600, B921600 }, { 1000000, B1000000 }, { 1152000, B1152000 },
+	{ 1500000, B1500000 }, { 2000000, B2000000 }, { 2500000, B2500000 },
+	{ 3000000, B3000000 },
+};
+
+/* raw 8N1 at the given rate; the bridge picks it up from SET_LINE_CODING */
+static int open_port(const char *path, unsigned long baud)
+{
+	struct termios tio;
+	size_t i;
+	int fd;
+
+	for (i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++)
+		if (speeds[i].baud == baud)
+			break;
+	if (i == sizeof(speeds) / sizeof(speeds[0])) {
+		fprintf(stderr, "cdcbench: %lu baud is not a termios rate\n", baud);
+		exit(2);
+	}
+
+	fd = open(path, O_RDWR | O_NOCTTY);
+	if (fd < 0)
+		die(path);
+	if (tcgetattr(fd, &tio) < 0)
+		die("tcgetattr");
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+	cfsetspeed(&tio, speeds[i].speed);
+	if (tcsetattr(fd, TCSANOW, &tio) < 0)
+		die("tcsetattr");
+	tcflush(fd, TCIOFLUSH);
+	return fd;
+}
+
+/* wait up to ms for fd to be readable */
+static int readable(int fd, int ms)
+{
+	struct pollfd p = { fd, POLLIN, 0 };
+
+	return poll(&p, 1, ms) > 0;
+}
+
+/* throw away whatever is still in flight */
+static void drain(int fd)
+{
+	uint8_t buf[256];
+
+	while (readable(fd, 100))
+		if (read(fd, buf, sizeof(buf)) <= 0)
+			break;
+}
+
+/* the stand-in for the hardware: one direction of the bridge, bytes in
+   on one pty master and out on another (or the same one, for a jumper) */
+static void *standin_thread(void *arg)
+{
+	struct standin *s = arg;
+	uint8_t buf[STANDIN_PACKET];
+	uint64_t held = 0, line = 0, t;
+	size_t fill = 0;
+	ssize_t n;
+	int ms;
+
+	for (;;) {
+		ms = -1;
+		if (fill) {
+			t = now_ns() - held;
+			ms = t >= STANDIN_HOLD_NS? 0: (STANDIN_HOLD_NS - t) / 1000000 + 1;
+		}
+		if (fill < sizeof(buf) && readable(s->in, ms)) {
+			n = read(s->in, buf + fill, sizeof(buf) - fill);
+			if (n <= 0)
+				break;	/* EIO: the last user of the slave has gone */
+			if (!fill)
+				held = now_ns();
+			fill += n;
+		}
+		if (fill == sizeof(buf) || (fill && now_ns() - held >= STANDIN_HOLD_NS)) {
+			/* ten bit times a byte on the wire */
+			t = now_ns();
+			line = (line > t? line: t) + fill * 10000000000ULL / s->baud;
+			sleep_until(line);
+			if (write(s->out, buf, fill) != (ssize_t) fill)
+				break;
+			fill = 0;
+		}
+	}
+	return NULL;
+}
+
+/* pseudo-terminal masters for the stand-in; returns the slave's name */
+static char *open_standin_pty(int *master)
+{
+	char *name;
+
+	*master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (*master < 0 || grantpt(*master) < 0 || unlockpt(*master) < 0)
+		die("posix_openpt");
+	name = ptsname(*master);
+	if (!name)
+		die("ptsname");
+	return strdup(name);
+}
+
+static void start_standin(int ports, unsigned long baud, char *path[2])
+{
+	static struct standin s[2];
+	static int master[2];
+	pthread_t thread;
+	int i;
+
+	for (i = 0; i < ports; i++)
+		path[i] = open_standin_pty(&master[i]);
+	for (i = 0; i < ports; i++) {
+		s[i].in = master[i];
+		s[i].out = master[ports == 2? !i: i];
+		s[i].baud = baud;
+		if (pthread_create(&thread, NULL, standin_thread, &s[i]))
+			die("pthread_create");
+		pthread_detach(thread);
+	}
+}
+
+static void *writer_thread(void *arg)
+{
+	struct stream *s = arg;
+	uint8_t buf[4096];
+	uint64_t end = now_ns() + s->seconds * 1e9;
+	size_t i;
+	ssize_t n;
+
+	while (now_ns() < end) {
+		for (i = 0; i < sizeof(buf); i++)
+			buf[i] = pattern(s->sent + i);
+		n = write(s->tx_fd, buf, sizeof(buf));
+		if (n < 0)
+			die("write");
+		s->sent += n;
+	}
+	tcdrain(s->tx_fd);
+	s->writing = 0;
+	return NULL;
+}
+
+static void *reader_thread(void *arg)
+{
+	struct stream *s = arg;
+	uint8_t buf[4096];
+	ssize_t n, i;
+
+	for (;;) {
+		if (!readable(s->rx_fd, DRAIN_MS)) {
+			if (!s->writing)
+				break;
+			continue;
+		}
+		n = read(s->rx_fd, buf, sizeof(buf));
+		if (n < 0)
+			die("read");
+		if (n == 0)
+			continue;
+		s->last_ns = now_ns();
+		if (!s->received)
+			s->first_ns = s->last_ns;
+		for (i = 0; i < n; i++)
+			if (buf[i] != pattern(s->received + i))
+				s->mismatched++;
+		s->received += n;
+	}
+	return NULL;
+}
+
+static void run_streams(struct stream *s, int count)
+{
+	pthread_t w[2], r[2];
+	int i;
+
+	for (i = 0; i < count; i++) {
+		s[i].writing = 1;
+		if (pthread_create(&r[i], NULL, reader_thread, &s[i]) ||
+		    pthread_create(&w[i], NULL, writer_thread, &s[i]))
+			die("pthread_create");
+	}
+	for (i = 0; i < count; i++) {
+		pthread_join(w[i], NULL);
+		pthread_join(r[i], NULL);
+	}
+}
+
+static int report_stream(const struct stream *s)
+{
+	double t = (s->last_ns - s->first_ns) / 1e9;
+	uint64_t lost = s->sent > s->received? s->sent - s->received: 0;
+
+	printf("%-12s %12llu %12llu %9.3f %10llu %10llu\n", s->name,
+	       (unsigned long long) s->sent, (unsigned long long) s->received,
+	       t > 0? s->received / t / 1e6: 0.0,
+	       (unsigned long long) lost, (unsigned long long) s->mismatched);
+	return lost || s->mismatched;
+}
+
+/* echo port B back to itself, for rtt with two ports */
+static void *echo_thread(void *arg)
+{
+	int fd = *(int *) arg;
+	uint8_t buf[256];
+	ssize_t n;
+
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		if (write(fd, buf, n) != n)
+			break;
+	return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y? -1: x > y;
+}
+
+static double percentile(const uint64_t *sorted, int count, double p)
+{
+	return sorted[(int) ((count - 1) * p + 0.5)] / 1e3;
+}
+
+static int round_trips(int fd, int count, size_t size)
+{
+	uint8_t msg[4096], buf[4096];
+	uint64_t *rtt, t;
+	int done, lost = 0, mismatched = 0, i, j, n;
+
+	rtt = malloc(count * sizeof(*rtt));
+	if (!rtt)
+		die("malloc");
+
+	for (i = 0, done = 0; i < count; i++) {
+		for (j = 0; j < size; j++)
+			msg[j] = i + j;
+		t = now_ns();
+		if (write(fd, msg, size) != (ssize_t) size)
+			die("write");
+		for (n = 0; n < size; n += j) {
+			if (!readable(fd, RTT_TIMEOUT_MS))
+				break;
+			j = read(fd, buf + n, size - n);
+			if (j <= 0)
+				die("read");
+		}
+		if (n < size) {
+			lost++;
+			drain(fd);
+			continue;
+		}
+		rtt[done++] = now_ns() - t;
+		if (memcmp(buf, msg, size))
+			mismatched++;
+	}
+
+	printf("\nrtt: %d messages of %zu bytes, %d lost, %d mismatched\n",
+	       count, size, lost, mismatched);
+	if (done) {
+		qsort(rtt, done, sizeof(*rtt), compare_u64);
+		printf("rtt us: min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+		       rtt[0] / 1e3, percentile(rtt, done, 0.5),
+		       percentile(rtt, done, 0.9), percentile(rtt, done, 0.99),
+		       rtt[done - 1] / 1e3);
+	}
+	free(rtt);
+	return lost || mismatched;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: cdcbench [-b baud] [-t seconds] [-n messages] [-s size] tty [tty]\n"
+		"       cdcbench [-b baud] [-t seconds] [-n messages] [-s size] -L ports\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long baud = 115200;
+	double seconds = 5;
+	int messages = 1000, size = 16, standin = 0;
+	char *path[2];
+	int fd[2], ports, failed = 0, opt, i;
+	struct stream s[2];
+	pthread_t echo;
+
+	while ((opt = getopt(argc, argv, "b:t:n:s:L:")) != -1) {
+		switch (opt) {
+		case 'b': baud = strtoul(optarg, NULL, 0); break;
+		case 't': seconds = atof(optarg); break;
+		case 'n': messages = atoi(optarg); break;
+		case 's': size = atoi(optarg); break;
+		case 'L': standin = atoi(optarg); break;
+		default: usage();
+		}
+	}
+	if (size < 1 || size > 4096 || messages < 1)
+		usage();
+
+	if (standin) {
+		if (optind != argc || standin > 2)
+			usage();
+		ports = standin;
+		start_standin(ports, baud, path);
+	}
+	else {
+		ports = argc - optind;
+		if (ports < 1 || ports > 2)
+			usage();
+		for (i = 0; i < ports; i++)
+			path[i] = argv[optind + i];
+	}
+	for (i = 0; i < ports; i++)
+		fd[i] = open_port(path[i], baud);
+	if (ports == 1)
+		fd[1] = fd[0];
+
+	printf("%s%s%s at %lu baud%s\n", path[0], ports == 2? " and ": "",
+	       ports == 2? path[1]: "", baud, standin? " (stand-in)": "");
+	printf("\n%-12s %12s %12s %9s %10s %10s\n",
+	       "test", "sent", "received", "MB/s", "lost", "mismatched");
+
+	memset(s, 0, sizeof(s));
+	s[0].name = "stream A->B";
+	s[0].tx_fd = fd[0];
+	s[0].rx_fd = fd[1];
+	s[0].seconds = seconds;
+	run_streams(s, 1);
+	failed |= report_stream(&s[0]);
+	drain(fd[1]);
+
+	if (ports == 2) {
+		memset(s, 0, sizeof(s));
+		s[0].name = "duplex A->B";
+		s[0].tx_fd = fd[0];
+		s[0].rx_fd = fd[1];
+		s[1].name = "duplex B->A";
+		s[1].tx_fd = fd[1];
+		s[1].rx_fd = fd[0];
+		s[0].seconds = s[1].seconds = seconds;
+		run_streams(s, 2);
+		failed |= report_stream(&s[0]);
+		failed |= report_stream(&s[1]);
+		drain(fd[0]);
+		drain(fd[1]);
+
+		if (pthread_create(&echo, NULL, echo_thread, &fd[1]))
+			die("pthread_create");
+		pthread_detach(echo);
+	}
+	else
+		printf("%-12s (needs two ports)\n", "duplex");
+
+	failed |= round_trips(fd[0], messages, size);
+
+	return failed;
+}
@@ -427,6 +427,27 @@ void usb_send_in_buffer(uint8_t endpoint, size_t len);
  */
 bool usb_in_endpoint_busy(uint8_t endpoint);
 
+/** @brief Count the IN buffers an application may fill
+ *
+ * With ping-pong buffering on application endpoints (@p PPB_MODE of
+ * @p PPB_EPN_ONLY or @p PPB_ALL) each endpoint has two IN buffers, so the
+ * next one can be filled while the other is on the wire; without it there
+ * is one. This returns how many of them are not waiting to be sent. While
+ * it is non-zero, @p usb_get_in_buffer() returns a free buffer and @p
+ * usb_send_in_buffer() queues it behind any buffer already pending, so
+ *
+ *     while (usb_in_endpoint_free_banks(ep) && have_data())
+ *         usb_send_in_buffer(ep, fill(usb_get_in_buffer(ep)));
+ *
+ * keeps the endpoint busy every frame. It returns 0 while the device is
+ * not configured or the endpoint is halted.
+ *
+ * @param endpoint   The endpoint requested
+ * @returns
+ *    Return the number of free IN buffers: 0, 1 or (ping-pong) 2.
+ */
+uint8_t usb_in_endpoint_free_banks(uint8_t endpoint);
+
 /** @brief Halt an IN endpoint
  *
  * Set the ENDPOINT_HALT condition on an IN endpoint. Do not call this on
@@ -465,6 +486,22 @@ bool usb_in_endpoint_halted(uint8_t endpoint);
  */
 bool usb_out_endpoint_has_data(uint8_t endpoint);
 
+/** @brief Count the OUT buffers holding received data
+ *
+ * The OUT counterpart of @p usb_in_endpoint_free_banks(): how many of the
+ * endpoint's OUT buffers (two with ping-pong buffering, otherwise one)
+ * have received a transaction and not yet been given back with @p
+ * usb_arm_out_endpoint(). With ping-pong buffering the SIE can accept the
+ * next packet into the other buffer while the application consumes one.
+ * Buffers come back from @p usb_get_out_buffer() in the order they were
+ * received.
+ *
+ * @param endpoint   The endpoint requested
+ * @returns
+ *   Return the number of OUT buffers with data: 0, 1 or (ping-pong) 2.
+ */
+uint8_t usb_out_endpoint_pending_banks(uint8_t endpoint);
+
 /** @brief Re-enable reception on an OUT endpoint
  *
  * Re-enable reception on the specified endpoint. Call this function after
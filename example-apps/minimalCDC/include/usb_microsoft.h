@@ -38,7 +38,7 @@
 
 #include <stdint.h>
 
-#if defined(__XC16__) || defined(__XC32__)
+#if defined(__XC16__) || defined(__XC32__) || defined(USB_HOST_SIM)
 #pragma pack(push, 1)
 #elif __XC8
 #else
@@ -171,7 +171,7 @@ uint16_t MICROSOFT_CUSTOM_PROPERTY_DESCRIPTOR_FUNC(uint8_t interface,
 /* Doxygen end-of-group for microsoft_items */
 /** @}*/
 
-#if defined(__XC16__) || defined(__XC32__)
+#if defined(__XC16__) || defined(__XC32__) || defined(USB_HOST_SIM)
 #pragma pack(pop)
 #elif __XC8
 #else
@@ -36,36 +36,138 @@
 #include "usb_ch9.h"
 #include "usb_cdc.h"
 
-/* local data buffers for CDC functionality */
-static uint8_t PC2PIC_Buffer[EP_2_LEN];
-static uint8_t PIC2PC_Buffer[EP_2_LEN];
+/* With ZERO_COPY the USART works straight out of the endpoint buffers: the
+   interrupt handler transmits from the EP2 OUT buffer the main loop holds,
+   and receives into the EP2 IN buffer it has claimed, so the two FIFOs
+   below are not needed.  When there is no IN buffer to receive into,
+   reception waits in the EUSART (RCIE is masked), so use PPB_EPN_ONLY in
+   usb_config.h to have a second bank filling while the first is sent. */
+//#define ZERO_COPY
+
+#ifdef ZERO_COPY
+static const uint8_t *PC2PIC_buf;
+static volatile uint8_t PC2PIC_pos, PC2PIC_len;	/* the handler advances pos to len */
+static uint8_t PC2PIC_held;			/* PC2PIC_buf still needs re-arming */
+
+static uint8_t *PIC2PC_buf;
+static volatile uint8_t PIC2PC_fill;		/* bytes the handler has put in PIC2PC_buf */
+static volatile uint8_t PIC2PC_claimed;		/* PIC2PC_buf is an IN bank not yet sent */
+#else
+/* circular FIFOs between USB and the USART; the size must be a power of two
+   of at least two packets, so that EP2 OUT can be re-armed while the USART
+   is still draining the previous packet */
+#define FIFO_SIZE 128
+#define FIFO_MASK (FIFO_SIZE - 1)
+
+static uint8_t PC2PIC_Fifo[FIFO_SIZE];
+static uint8_t PIC2PC_Fifo[FIFO_SIZE];
+
+/* free-running indices; occupancy is (uint8_t)(head - tail); the USART
+   interrupt owns PIC2PC_head and PC2PIC_tail, the main loop the other two */
+static volatile uint8_t PC2PIC_head, PC2PIC_tail;
+static volatile uint8_t PIC2PC_head, PIC2PC_tail;
+#endif
+
+/* EP2 IN coalescing: a packet goes out when a full one is waiting, or when
+   IN_COALESCE_FRAMES start-of-frames (1ms each) have passed since the last
+   one; at high rates every packet is full, at low rates nothing waits
+   longer than that */
+#ifndef IN_COALESCE_FRAMES
+#define IN_COALESCE_FRAMES 2
+#endif
 
-/* variables to track positions and occupancy in local CDC buffers */
-uint8_t PIC2PC_pending_count;
-size_t  PC2PIC_buffer_occupancy;
-uint8_t PC2PIC_read_index;
+static volatile uint8_t in_frames;	/* SOFs since the last EP2 IN packet, saturating */
+static uint8_t in_zlp_pending;		/* last packet was full, so the transfer needs ending */
+
+/* USART receive error counters, maintained by the interrupt handler */
+static volatile uint16_t uart_overruns;		/* OERR: the EUSART's own 2-byte FIFO overflowed */
+static volatile uint16_t uart_framing_errors;	/* FERR: bad stop bit */
+static volatile uint16_t uart_dropped;		/* received while PIC2PC_Fifo was full (not with ZERO_COPY) */
+static volatile uint16_t uart_parity_errors;	/* only counted with even/odd parity */
+
+/* USB side counters, kept by the main loop */
+static uint32_t usb_out_bytes;		/* taken from EP2 OUT, PC to PIC */
+static uint32_t usb_in_bytes;		/* sent on EP2 IN, PIC to PC */
+static uint8_t PC2PIC_max, PIC2PC_max;	/* most bytes seen waiting for the USART / for EP2 IN */
+
+/* vendor request (bmRequestType 0xC0) returning struct bridge_counters,
+   18 bytes little-endian; with wValue 1 the counters are cleared once they
+   have been read */
+#define VENDOR_GET_COUNTERS 0x01
+
+struct bridge_counters {
+	uint32_t usb_out_bytes;
+	uint32_t usb_in_bytes;
+	uint16_t uart_dropped;
+	uint16_t uart_overruns;
+	uint16_t uart_framing_errors;
+	uint16_t uart_parity_errors;
+	uint8_t PC2PIC_max;
+	uint8_t PIC2PC_max;
+};
+
+/* the snapshot belongs to the stack until the data stage is over */
+static struct bridge_counters counters;
+
+/* USART errors not yet reported in a SERIAL_STATE notification on EP1, in
+   the bits the notification uses; the interrupt handler sets them */
+#define SERIAL_STATE_FRAMING 0x10
+#define SERIAL_STATE_PARITY  0x20
+#define SERIAL_STATE_OVERRUN 0x40
+
+static volatile uint8_t uart_events;
+static uint8_t serial_state_due;	/* the host hasn't seen a notification since configuration */
+
+/* the EUSART runs from the 48MHz instruction clock with BRG16 = BRGH = 1,
+   ie. baud = FOSC / (4 * (SPBRGH:SPBRG + 1)) */
+#define FOSC          48000000UL
+#define UART_MIN_BAUD 300UL
+#define UART_MAX_BAUD 3000000UL
+
+/* how frames are built beyond the EUSART's native 8N1; the ninth bit (TX9)
+   carries parity, mark/space or a second stop bit for 8 data bits, and
+   bit 7 of an 8-bit frame does the same for 7 data bits */
+#define FORMAT_PARITY  0x01 /* even or odd parity computed per byte */
+#define FORMAT_ODD     0x02
+#define FORMAT_7BIT    0x04
+#define FORMAT_BIT7_SET 0x08 /* 7 data bits with mark parity or 2 stop bits */
+
+static volatile uint8_t uart_format;
+
+/* the line coding in effect, as reported to GET_LINE_CODING */
+static struct cdc_line_coding line_coding;
 
 static void InitializeUSART(void);
+static uint8_t parity(uint8_t c);
+static void send_serial_state(void);
+#ifndef ZERO_COPY
+static void fifo_put(uint8_t *fifo, volatile uint8_t *head, const uint8_t *src, uint8_t len);
+static void fifo_get(const uint8_t *fifo, volatile uint8_t *tail, uint8_t *dst, uint8_t len);
+#endif
 
 int main(void)
 {
-	uint8_t pc2pic_data_ready;
-	uint8_t *in_buf;
+	uint8_t len;
+#ifndef ZERO_COPY
 	const uint8_t *out_buf;
-	int i;
-
-	pc2pic_data_ready = 0;
+#endif
 
 	InitializeUSART();
 
-	PIC2PC_pending_count = 0;
-	PC2PIC_buffer_occupancy = 0;
+#ifdef ZERO_COPY
+	PC2PIC_pos = PC2PIC_len = 0;
+	PC2PIC_held = 0;
+	PIC2PC_claimed = 0;
+#else
+	PC2PIC_head = PC2PIC_tail = 0;
+	PIC2PC_head = PIC2PC_tail = 0;
 
-/* Configure interrupts, per architecture */
-#ifdef USB_USE_INTERRUPTS
+	PIE1bits.RCIE = 1;
+#endif
+
+	/* the USART is interrupt driven; USB may be too (USB_USE_INTERRUPTS) */
 	INTCONbits.PEIE = 1;
 	INTCONbits.GIE = 1;
-#endif
 
 	usb_init();
 
@@ -77,77 +179,416 @@ int main(void)
 
 		/* if USB isn't configured, there is no point in proceeding further */
 		if (!usb_is_configured())
+		{
+			serial_state_due = 1;
+#ifdef ZERO_COPY
+			/* the stack re-arms the endpoints on configuration, so
+			   whatever buffers were held are no longer ours */
+			PIE1bits.RCIE = 0;
+			PIE1bits.TXIE = 0;
+			PC2PIC_pos = PC2PIC_len = 0;
+			PC2PIC_held = 0;
+			PIC2PC_claimed = 0;
+#endif
 			continue;
+		}
+
+		/* tell the host about USART errors as they happen (and the line state once configured) */
+		if ((uart_events || serial_state_due) && usb_in_endpoint_free_banks(1))
+			send_serial_state();
 
-		/* if the USART has received another byte, add it to the queue if there is room */
-		if (PIR1bits.RCIF && (PIC2PC_pending_count < (EP_2_LEN - 1)))
+#ifdef ZERO_COPY
+		/* once the USART has sent all of the OUT buffer, give it back and start on the next one */
+		if (PC2PIC_pos == PC2PIC_len)
 		{
-			if (RCSTAbits.OERR)
-				RCSTAbits.CREN = 0;  /* in case of overrun error, reset the port */
-			PIC2PC_Buffer[PIC2PC_pending_count] = RCREG;
-			RCSTAbits.CREN = 1;  /* and then (re-)enable receive */
-			++PIC2PC_pending_count;
+			if (PC2PIC_held)
+			{
+				usb_arm_out_endpoint(2);
+				PC2PIC_held = 0;
+			}
+			if (usb_out_endpoint_has_data(2))
+			{
+				PIE1bits.TXIE = 0;
+				len = usb_get_out_buffer(2, &PC2PIC_buf);
+				PC2PIC_pos = 0;
+				PC2PIC_len = len;
+				PC2PIC_held = 1;
+				usb_out_bytes += len;
+				if (len > PC2PIC_max)
+					PC2PIC_max = len;
+				/* the transmit interrupt disables itself when it reaches the end of the buffer */
+				PIE1bits.TXIE = 1;
+			}
 		}
 
-		/* if our PC2PIC buffer is not empty *AND* the USART can accept another byte, transmit another byte */
-		if (pc2pic_data_ready && TXSTAbits.TRMT)
+		/* send the claimed IN buffer under the IN_COALESCE_FRAMES policy */
+		if (PIC2PC_claimed)
 		{
-			/* transmit another byte from buffer */
-			TXREG = PC2PIC_Buffer[PC2PIC_read_index];
-			/* update the read index */
-	    		++PC2PIC_read_index;
-			/* if the read_index has reached the occupancy value, signal that the buffer is empty again */
-	    		if (PC2PIC_read_index == PC2PIC_buffer_occupancy)
-	    			pc2pic_data_ready = 0;
+			len = PIC2PC_fill;
+			if (len > PIC2PC_max)
+				PIC2PC_max = len;
+			if (len >= EP_2_IN_LEN || (len && in_frames >= IN_COALESCE_FRAMES)
+			    || (!len && in_zlp_pending && in_frames >= IN_COALESCE_FRAMES))
+			{
+				/*
+				no more bytes may land in it once the length is taken; clearing RCIE isn't enough on its own,
+				as the ISR also empties the EUSART when it runs for TXIF or USB, so the claim goes first
+				*/
+				PIE1bits.RCIE = 0;
+				PIC2PC_claimed = 0;
+				len = PIC2PC_fill;
+				usb_send_in_buffer(2, len);
+				usb_in_bytes += len;
+				in_zlp_pending = (len == EP_2_IN_LEN);
+				in_frames = 0;
+			}
 		}
 
-		/* proceed further only if the PC can accept more data */
-		if (usb_in_endpoint_halted(2) || usb_in_endpoint_busy(2))
+		/* claim the next IN bank for the receive interrupt to fill */
+		if (!PIC2PC_claimed && usb_in_endpoint_free_banks(2))
+		{
+			PIC2PC_buf = usb_get_in_buffer(2);
+			PIC2PC_fill = 0;
+			PIC2PC_claimed = 1;
+			PIE1bits.RCIE = 1;
+		}
+#else
+		/* as soon as the PC2PIC FIFO has room for a whole packet, take one from the PC and re-arm */
+		if (usb_out_endpoint_has_data(2) && ((uint8_t)(PC2PIC_head - PC2PIC_tail) <= FIFO_SIZE - EP_2_OUT_LEN))
+		{
+			len = usb_get_out_buffer(2, &out_buf);
+			fifo_put(PC2PIC_Fifo, &PC2PIC_head, out_buf, len);
+			usb_arm_out_endpoint(2);
+			usb_out_bytes += len;
+			len = (uint8_t)(PC2PIC_head - PC2PIC_tail);
+			if (len > PC2PIC_max)
+				PC2PIC_max = len;
+			/* the transmit interrupt drains the FIFO and disables itself when it is empty */
+			PIE1bits.TXIE = 1;
+		}
+
+		/* hand the USART's data to EP2 IN a full packet at a time, or whatever there is once the frame budget has run out */
+		if (!usb_in_endpoint_free_banks(2))
 			continue;
+		len = (uint8_t)(PIC2PC_head - PIC2PC_tail);
+		if (len > PIC2PC_max)
+			PIC2PC_max = len;
+		if (len >= EP_2_IN_LEN || (len && in_frames >= IN_COALESCE_FRAMES))
+		{
+			if (len > EP_2_IN_LEN)
+				len = EP_2_IN_LEN;
+			fifo_get(PIC2PC_Fifo, &PIC2PC_tail, usb_get_in_buffer(2), len);
+			usb_send_in_buffer(2, len);
+			usb_in_bytes += len;
+			in_zlp_pending = (len == EP_2_IN_LEN);
+			in_frames = 0;
+		}
+		else if (!len && in_zlp_pending && in_frames >= IN_COALESCE_FRAMES)
+		{
+			/* the data stopped on a packet boundary; a zero-length packet
+			   completes the host's read instead of leaving it waiting */
+			usb_send_in_buffer(2, 0);
+			in_zlp_pending = 0;
+			in_frames = 0;
+		}
+#endif
+	}
+}
+
+#ifndef ZERO_COPY
+/* copy into/out of a FIFO in at most two pieces, either side of the wrap */
+
+static void fifo_put(uint8_t *fifo, volatile uint8_t *head, const uint8_t *src, uint8_t len)
+{
+	uint8_t index = *head & FIFO_MASK;
+	uint8_t first = FIFO_SIZE - index;
+
+	if (first > len)
+		first = len;
+	memcpy(fifo + index, src, first);
+	memcpy(fifo, src + first, len - first);
+	*head += len;
+}
+
+static void fifo_get(const uint8_t *fifo, volatile uint8_t *tail, uint8_t *dst, uint8_t len)
+{
+	uint8_t index = *tail & FIFO_MASK;
+	uint8_t first = FIFO_SIZE - index;
+
+	if (first > len)
+		first = len;
+	memcpy(dst, fifo + index, first);
+	memcpy(dst + first, fifo, len - first);
+	*tail += len;
+}
+#endif
 
-		/* if we've reached here, the USB stack can accept more; if we have PIC2PC data to send, we hand it over */
-		if (PIC2PC_pending_count > 0)
+void interrupt isr()
+{
+	uint8_t c, bit9;
+
+	/* empty the EUSART's 2-byte receive FIFO into PIC2PC_Fifo (or PIC2PC_buf) */
+	while (PIR1bits.RCIF)
+	{
+#ifdef ZERO_COPY
+		/* leave it in the EUSART until the main loop has an IN buffer with room */
+		if (!PIC2PC_claimed || PIC2PC_fill == EP_2_IN_LEN)
+		{
+			PIE1bits.RCIE = 0;
+			break;
+		}
+#endif
+		/* FERR and RX9D belong to the byte about to be read from RCREG */
+		if (RCSTAbits.FERR)
 		{
-			in_buf = usb_get_in_buffer(2);
-			memcpy(in_buf, PIC2PC_Buffer, PIC2PC_pending_count);
-			usb_send_in_buffer(2, PIC2PC_pending_count);
-			PIC2PC_pending_count = 0;
+			++uart_framing_errors;
+			uart_events |= SERIAL_STATE_FRAMING;
 		}
+		if (uart_format & FORMAT_7BIT)
+		{
+			c = RCREG;
+			if ((uart_format & FORMAT_PARITY) && (parity(c) != ((uart_format & FORMAT_ODD) ? 1 : 0)))
+			{
+				++uart_parity_errors;
+				uart_events |= SERIAL_STATE_PARITY;
+			}
+			c &= 0x7F;
+		}
+		else
+		{
+			bit9 = RCSTAbits.RX9D;
+			c = RCREG;
+			if ((uart_format & FORMAT_PARITY) && ((parity(c) ^ bit9) != ((uart_format & FORMAT_ODD) ? 1 : 0)))
+			{
+				++uart_parity_errors;
+				uart_events |= SERIAL_STATE_PARITY;
+			}
+		}
+#ifdef ZERO_COPY
+		PIC2PC_buf[PIC2PC_fill++] = c;
+#else
+		if ((uint8_t)(PIC2PC_head - PIC2PC_tail) < FIFO_SIZE)
+			PIC2PC_Fifo[PIC2PC_head++ & FIFO_MASK] = c;
+		else
+		{
+			++uart_dropped;
+			uart_events |= SERIAL_STATE_OVERRUN;
+		}
+#endif
+	}
 
-		/* if our PC2PIC buffer is NOT empty, we won't go further (where we would try to accept more from the PC) */
-		if (pc2pic_data_ready)
-			continue;
+	/* an overrun stops reception until CREN is cycled */
+	if (RCSTAbits.OERR)
+	{
+		++uart_overruns;
+		uart_events |= SERIAL_STATE_OVERRUN;
+		RCSTAbits.CREN = 0;
+		RCSTAbits.CREN = 1;
+	}
 
-		/* if we pass this test, we are committed to make the usb_arm_out_endpoint() call */
-		if (!usb_out_endpoint_has_data(2))
-			continue;
+	/* keep TXREG loaded while there is PC2PIC data */
+	if (PIE1bits.TXIE && PIR1bits.TXIF)
+	{
+#ifdef ZERO_COPY
+		if (PC2PIC_pos != PC2PIC_len)
+		{
+			c = PC2PIC_buf[PC2PIC_pos++];
+#else
+		if (PC2PIC_head != PC2PIC_tail)
+		{
+			c = PC2PIC_Fifo[PC2PIC_tail++ & FIFO_MASK];
+#endif
+			if (uart_format & FORMAT_7BIT)
+			{
+				c &= 0x7F;
+				if (uart_format & FORMAT_PARITY)
+					c |= (parity(c) ^ ((uart_format & FORMAT_ODD) ? 1 : 0)) << 7;
+				else if (uart_format & FORMAT_BIT7_SET)
+					c |= 0x80;
+			}
+			else if (uart_format & FORMAT_PARITY)
+			{
+				/* TX9D must be written before TXREG */
+				TXSTAbits.TX9D = parity(c) ^ ((uart_format & FORMAT_ODD) ? 1 : 0);
+			}
+			TXREG = c;
+		}
+		else
+			PIE1bits.TXIE = 0;
+	}
 
-		/* ask USB stack for more PC2PIC data */
-		PC2PIC_buffer_occupancy = usb_get_out_buffer(2, &out_buf);
+#ifdef USB_USE_INTERRUPTS
+	/* usb_service() runs after the USART has been serviced, as there is
+	   only one interrupt priority; at high baud rates polled USB (the
+	   default) keeps the USART latency lowest */
+	usb_service();
+#endif
+}
 
-		/* if there was any, put it in the buffer and update the state variables */
-		if(PC2PIC_buffer_occupancy > 0)
+/* even parity of a byte: 1 if it has an odd number of ones */
+static uint8_t parity(uint8_t c)
+{
+	c ^= c >> 4;
+	c ^= c >> 2;
+	c ^= c >> 1;
+	return c & 1;
+}
+
+/* SERIAL_STATE notification on EP1 IN with the errors since the last one */
+static void send_serial_state(void)
+{
+	struct cdc_serial_state_notification *n = (struct cdc_serial_state_notification *)usb_get_in_buffer(1);
+	uint8_t events = uart_events;
+
+	/* anything the interrupt handler adds from here on goes in the next one */
+	uart_events &= ~events;
+
+	n->header.REQUEST.bmRequestType = 0xA1;
+	n->header.bNotification = CDC_SERIAL_STATE;
+	n->header.wValue = 0;
+	n->header.wIndex = 0; /* the communications interface */
+	n->header.wLength = 2;
+	/* there are no modem lines; DCD and DSR are reported as present */
+	n->data.serial_state = events | 0x03;
+	usb_send_in_buffer(1, sizeof(*n));
+	serial_state_due = 0;
+}
+
+/* called from usb_service() once per 1ms frame */
+void app_start_of_frame_callback(void)
+{
+	if (in_frames != 0xFF)
+		++in_frames;
+}
+
+int8_t app_unknown_setup_request_callback(const struct setup_packet *setup)
+{
+	uint8_t gie;
+
+	if (setup->REQUEST.type == REQUEST_TYPE_VENDOR &&
+	    setup->REQUEST.destination == DEST_DEVICE &&
+	    setup->bRequest == VENDOR_GET_COUNTERS)
+	{
+		/* stall a request with no IN data stage, before wValue 1 clears anything */
+		if (!setup->REQUEST.direction || setup->wLength == 0)
+			return -1;
+
+		/* the interrupt handler must not update the counters halfway through the copy */
+		gie = INTCONbits.GIE;
+		INTCONbits.GIE = 0;
+		counters.usb_out_bytes = usb_out_bytes;
+		counters.usb_in_bytes = usb_in_bytes;
+		counters.uart_dropped = uart_dropped;
+		counters.uart_overruns = uart_overruns;
+		counters.uart_framing_errors = uart_framing_errors;
+		counters.uart_parity_errors = uart_parity_errors;
+		counters.PC2PIC_max = PC2PIC_max;
+		counters.PIC2PC_max = PIC2PC_max;
+		if (setup->wValue == 1)
 		{
-			memcpy(PC2PIC_Buffer, out_buf, PC2PIC_buffer_occupancy);
-			/* signal that the buffer is not empty */
-			pc2pic_data_ready = 1;
-			/* rewind read index to the beginning of the buffer */
-			PC2PIC_read_index = 0;
+			usb_out_bytes = usb_in_bytes = 0;
+			uart_dropped = uart_overruns = 0;
+			uart_framing_errors = uart_parity_errors = 0;
+			PC2PIC_max = PIC2PC_max = 0;
 		}
+		INTCONbits.GIE = gie;
 
-		usb_arm_out_endpoint(2);
+		/* never send more than the host asked for */
+		usb_send_data_stage((char *)&counters,
+		                    (setup->wLength < sizeof(counters)) ? setup->wLength : sizeof(counters),
+		                    NULL, NULL);
+		return 0;
 	}
+
+	/* everything else is for the CDC class; see usb_cdc.h */
+	return process_cdc_setup_request(setup);
 }
 
-void interrupt isr()
+/* CDC Callbacks. See usb_cdc.h for documentation. */
+
+void app_set_line_coding_callback(uint8_t interface,
+                                    const struct cdc_line_coding *coding)
 {
-#ifdef USB_USE_INTERRUPTS
-    usb_service();
-#endif
+	uint32_t baud = coding->dwDTERate;
+	uint16_t brg;
+	uint8_t format, nine_bits, bit9, gie;
+
+	if (baud < UART_MIN_BAUD)
+		baud = UART_MIN_BAUD;
+	if (baud > UART_MAX_BAUD)
+		baud = UART_MAX_BAUD;
+
+	/* nearest divisor; report the rate that divisor actually gives */
+	brg = (uint16_t)((FOSC / 4 + baud / 2) / baud - 1);
+	line_coding.dwDTERate = FOSC / 4 / (brg + 1UL);
+
+	/* anything the EUSART cannot frame falls back to (and reports) 8N1 */
+	format = 0;
+	nine_bits = 0;
+	bit9 = 0;
+	line_coding.bDataBits = 8;
+	line_coding.bParityType = CDC_PARITY_NONE;
+	line_coding.bCharFormat = CDC_CHAR_FORMAT_1_STOP_BIT;
+
+	if (coding->bDataBits == 8)
+	{
+		if (coding->bParityType != CDC_PARITY_NONE || coding->bCharFormat == CDC_CHAR_FORMAT_2_STOP_BITS)
+		{
+			/* the ninth bit is parity, mark/space or (no parity) the second stop bit */
+			nine_bits = 1;
+			bit9 = (coding->bParityType == CDC_PARITY_SPACE) ? 0 : 1;
+			if (coding->bParityType == CDC_PARITY_EVEN || coding->bParityType == CDC_PARITY_ODD)
+				format = FORMAT_PARITY;
+			line_coding.bParityType = coding->bParityType;
+			/* with parity there is no room for a second stop bit */
+			if (coding->bParityType == CDC_PARITY_NONE)
+				line_coding.bCharFormat = CDC_CHAR_FORMAT_2_STOP_BITS;
+		}
+	}
+	else if (coding->bDataBits == 7)
+	{
+		/* bit 7 carries parity, mark/space or (no parity) the second stop bit */
+		format = FORMAT_7BIT;
+		line_coding.bDataBits = 7;
+		line_coding.bParityType = coding->bParityType;
+		if (coding->bParityType == CDC_PARITY_EVEN || coding->bParityType == CDC_PARITY_ODD)
+			format |= FORMAT_PARITY;
+		else if (coding->bParityType != CDC_PARITY_SPACE)
+			format |= FORMAT_BIT7_SET;
+		if (coding->bParityType == CDC_PARITY_NONE)
+			line_coding.bCharFormat = CDC_CHAR_FORMAT_2_STOP_BITS;
+	}
+	if (coding->bParityType == CDC_PARITY_ODD)
+		format |= FORMAT_ODD;
+	if (!(format & FORMAT_7BIT) && !nine_bits)
+		format = 0;
+
+	/* this may run in the interrupt handler (USB_USE_INTERRUPTS), so
+	   restore GIE rather than setting it */
+	gie = INTCONbits.GIE;
+	INTCONbits.GIE = 0;
+	RCSTAbits.SPEN = 0;
+	SPBRGH = brg >> 8;
+	SPBRG  = brg & 0xFF;
+	TXSTAbits.TX9 = nine_bits;
+	RCSTAbits.RX9 = nine_bits;
+	TXSTAbits.TX9D = bit9;
+	uart_format = format;
+	RCSTAbits.SPEN = 1;
+	INTCONbits.GIE = gie;
+}
+
+int8_t app_get_line_coding_callback(uint8_t interface,
+                                    struct cdc_line_coding *coding)
+{
+	*coding = line_coding;
+	return 0;
 }
 
 static void InitializeUSART(void)
 {
+	struct cdc_line_coding coding;
+
 	/* RX on RC5 is an input */
         TRISCbits.TRISC5=1;
 
@@ -157,12 +598,16 @@ static void InitializeUSART(void)
 	TXSTA = 0x24;
 	RCSTA = 0x90;
 
-	/* 115200 bps */
-	SPBRG  = 103;
-	SPBRGH = 0;
-
+	/* BRG16 */
 	BAUDCON = 0x08;
 
+	/* 115200 8N1 until the host says otherwise */
+	coding.dwDTERate = 115200;
+	coding.bCharFormat = CDC_CHAR_FORMAT_1_STOP_BIT;
+	coding.bParityType = CDC_PARITY_NONE;
+	coding.bDataBits = 8;
+	app_set_line_coding_callback(0, &coding);
+
 	/* clear any data in receive buffer */
 	(volatile void)RCREG;
 }
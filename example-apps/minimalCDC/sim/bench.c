@@ -0,0 +1,418 @@
+/*
+    usb_service() benchmark for the minimalCDC M-Stack copy, built on the
+    host against the simulated SIE (see sim_sie.c)
+
+    A scripted host drives three workloads: enumeration (bus reset through
+    SET_CONFIGURATION), control requests on a configured device, and bulk
+    64-byte packets looped back through EP2 by a firmware loop shaped like
+    main.c's.  Every usb_service() call is timed (and its user-space
+    instructions counted, where perf events are available); calls that
+    found an interrupt flag set are reported separately from idle polls.
+
+    usage: bench [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "xc.h"
+#include "sim_sie.h"
+#include "usb_config.h"
+#include "usb.h"
+#include "usb_ch9.h"
+#include "usb_cdc.h"
+
+/* how many times a NAKed token is retried before the script gives up */
+#define MAX_RETRIES 100
+
+#define DEVICE_ADDRESS 5
+#define DATA_EP 2
+
+struct phase {
+	const char *name;
+	unsigned long transfers;
+	unsigned long busy_calls, idle_calls;
+	uint64_t busy_ns, idle_ns;
+	uint64_t busy_insns, idle_insns;
+};
+
+static struct phase *phase;
+static int perf_fd = -1;
+static uint64_t overhead_ns, overhead_insns;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t insns(void)
+{
+	uint64_t count = 0;
+
+	if (perf_fd >= 0 && read(perf_fd, &count, sizeof(count)) != sizeof(count))
+		count = 0;
+	return count;
+}
+
+static void open_perf(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	perf_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if (perf_fd >= 0)
+		ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+/* cost of the measurement itself, subtracted from every sample */
+static void calibrate(void)
+{
+	uint64_t t, n, best_t = UINT64_MAX, best_n = UINT64_MAX;
+	int i;
+
+	for (i = 0; i < 10000; i++) {
+		n = insns();
+		t = now_ns();
+		t = now_ns() - t;
+		n = insns() - n;
+		if (t < best_t)
+			best_t = t;
+		if (n < best_n)
+			best_n = n;
+	}
+	overhead_ns = best_t;
+	overhead_insns = perf_fd >= 0? best_n: 0;
+}
+
+/* the firmware side: one usb_service() and one pass of the app loop */
+static void device_step(void)
+{
+	uint64_t t, n;
+	int busy;
+
+	busy = UIRbits.URSTIF || UIRbits.TRNIF || UIRbits.STALLIF || UIRbits.SOFIF;
+
+	n = insns();
+	t = now_ns();
+	usb_service();
+	t = now_ns() - t;
+	n = insns() - n;
+
+	t = t > overhead_ns? t - overhead_ns: 0;
+	n = n > overhead_insns? n - overhead_insns: 0;
+	if (busy) {
+		phase->busy_calls++;
+		phase->busy_ns += t;
+		phase->busy_insns += n;
+	}
+	else {
+		phase->idle_calls++;
+		phase->idle_ns += t;
+		phase->idle_insns += n;
+	}
+
+	/* CDC loopback, as main.c does it with the UART in the middle */
+	if (!usb_is_configured())
+		return;
+	while (usb_out_endpoint_pending_banks(DATA_EP) &&
+	       usb_in_endpoint_free_banks(DATA_EP)) {
+		const unsigned char *out_buf;
+		uint8_t len = usb_get_out_buffer(DATA_EP, &out_buf);
+
+		memcpy(usb_get_in_buffer(DATA_EP), out_buf, len);
+		usb_send_in_buffer(DATA_EP, len);
+		usb_arm_out_endpoint(DATA_EP);
+	}
+}
+
+/* callbacks main.c provides on the real device */
+
+static struct cdc_line_coding line_coding;
+
+void app_set_line_coding_callback(uint8_t interface,
+                                  const struct cdc_line_coding *coding)
+{
+	line_coding = *coding;
+}
+
+int8_t app_get_line_coding_callback(uint8_t interface,
+                                    struct cdc_line_coding *coding)
+{
+	*coding = line_coding;
+	return 0;
+}
+
+void app_start_of_frame_callback(void)
+{
+}
+
+int8_t app_unknown_setup_request_callback(const struct setup_packet *setup)
+{
+	return process_cdc_setup_request(setup);
+}
+
+/* let the device work through whatever the bus has left it */
+static void settle(void)
+{
+	do
+		device_step();
+	while (UIRbits.URSTIF || UIRbits.TRNIF || UIRbits.STALLIF || UIRbits.SOFIF);
+}
+
+static void fail(const char *what)
+{
+	fprintf(stderr, "bench: %s failed in %s phase\n", what, phase->name);
+	exit(1);
+}
+
+static int setup_token(const void *pkt)
+{
+	int i, r;
+
+	for (i = 0; i < MAX_RETRIES; i++) {
+		r = sim_setup(pkt);
+		if (r != SIM_NAK)
+			return r;
+		device_step();
+	}
+	return SIM_NAK;
+}
+
+static int out_token(uint8_t ep, const void *data, size_t len)
+{
+	int i, r;
+
+	for (i = 0; i < MAX_RETRIES; i++) {
+		r = sim_out(ep, data, len);
+		if (r != SIM_NAK)
+			return r;
+		device_step();
+	}
+	return SIM_NAK;
+}
+
+static int in_token(uint8_t ep, void *data, size_t max_len, size_t *len)
+{
+	int i, r;
+
+	for (i = 0; i < MAX_RETRIES; i++) {
+		r = sim_in(ep, data, max_len, len);
+		if (r != SIM_NAK)
+			return r;
+		device_step();
+	}
+	return SIM_NAK;
+}
+
+/* a whole control transfer; returns the data stage length, or -1 on STALL */
+static int control(uint8_t request_type, uint8_t request, uint16_t value,
+                   uint16_t index, uint16_t length, void *data)
+{
+	uint8_t pkt[8] = {
+		request_type, request, value & 0xff, value >> 8,
+		index & 0xff, index >> 8, length & 0xff, length >> 8,
+	};
+	uint8_t *p = data;
+	size_t done = 0, len;
+	int r;
+
+	if (setup_token(pkt) != SIM_ACK)
+		fail("SETUP");
+
+	if (request_type & 0x80) {
+		while (done < length) {
+			r = in_token(0, p + done, EP_0_LEN, &len);
+			if (r == SIM_STALL)
+				return -1;
+			if (r != SIM_ACK)
+				fail("control IN");
+			done += len;
+			if (len < EP_0_LEN)
+				break;
+		}
+		r = out_token(0, NULL, 0);
+	}
+	else {
+		while (done < length) {
+			len = length - done < EP_0_LEN? length - done: EP_0_LEN;
+			r = out_token(0, p + done, len);
+			if (r == SIM_STALL)
+				return -1;
+			if (r != SIM_ACK)
+				fail("control OUT");
+			done += len;
+		}
+		r = in_token(0, NULL, 0, &len);
+	}
+	if (r == SIM_STALL)
+		return -1;
+	if (r != SIM_ACK)
+		fail("status stage");
+
+	settle();
+	phase->transfers++;
+	return done;
+}
+
+static void enumerate(void)
+{
+	uint8_t buf[256];
+	struct configuration_descriptor *config = (void *) buf;
+	int len;
+
+	sim_bus_reset();
+	settle();
+
+	if (control(0x80, GET_DESCRIPTOR, DESC_DEVICE << 8, 0, 64, buf) != sizeof(struct device_descriptor))
+		fail("first GET_DESCRIPTOR");
+
+	sim_bus_reset();
+	settle();
+
+	if (control(0x00, SET_ADDRESS, DEVICE_ADDRESS, 0, 0, NULL) < 0)
+		fail("SET_ADDRESS");
+	sim_set_address(DEVICE_ADDRESS);
+
+	if (control(0x80, GET_DESCRIPTOR, DESC_DEVICE << 8, 0, sizeof(struct device_descriptor), buf) < 0)
+		fail("GET_DESCRIPTOR(device)");
+	if (control(0x80, GET_DESCRIPTOR, DESC_CONFIGURATION << 8, 0, 9, buf) != 9)
+		fail("GET_DESCRIPTOR(configuration)");
+	len = config->wTotalLength;
+	if (control(0x80, GET_DESCRIPTOR, DESC_CONFIGURATION << 8, 0, len, buf) != len)
+		fail("GET_DESCRIPTOR(configuration, full)");
+	control(0x80, GET_DESCRIPTOR, DESC_STRING << 8, 0, 255, buf);
+
+	if (control(0x00, SET_CONFIGURATION, 1, 0, 0, NULL) < 0)
+		fail("SET_CONFIGURATION");
+	sim_reset_toggles(DATA_EP);
+	if (!usb_is_configured())
+		fail("configuration");
+}
+
+static void control_requests(void)
+{
+	struct cdc_line_coding coding = { 115200, 0, 0, 8 };
+	uint8_t buf[64];
+
+	if (control(0x80, GET_STATUS, 0, 0, 2, buf) != 2)
+		fail("GET_STATUS");
+	if (control(0x21, CDC_SET_LINE_CODING, 0, 0, sizeof(coding), &coding) < 0)
+		fail("SET_LINE_CODING");
+	if (control(0x80, GET_CONFIGURATION, 0, 0, 1, buf) != 1 || buf[0] != 1)
+		fail("GET_CONFIGURATION");
+}
+
+/* Packets go out back to back, as long as the device takes them, so
+   ping-pong buffering has something to overlap; a NAKed OUT makes the host
+   collect the oldest looped-back packet first. */
+#define WINDOW 8
+
+static void bulk_receive(uint8_t out[][EP_2_LEN], int index)
+{
+	uint8_t in[EP_2_LEN];
+	size_t len;
+
+	if (in_token(DATA_EP, in, sizeof(in), &len) != SIM_ACK)
+		fail("bulk IN");
+	if (len != EP_2_LEN || memcmp(in, out[index % WINDOW], len))
+		fail("bulk data compare");
+	phase->transfers++;
+}
+
+static void bulk_loopback(int count)
+{
+	uint8_t out[WINDOW][EP_2_LEN];
+	int sent = 0, received = 0;
+	int j, r;
+
+	while (received < count) {
+		if (sent < count && sent - received < WINDOW) {
+			for (j = 0; j < EP_2_LEN; j++)
+				out[sent % WINDOW][j] = sent + j;
+			r = sim_out(DATA_EP, out[sent % WINDOW], EP_2_LEN);
+			if (r == SIM_ACK) {
+				sent++;
+				continue;
+			}
+			if (r != SIM_NAK)
+				fail("bulk OUT");
+			device_step();
+			if (sim_out(DATA_EP, out[sent % WINDOW], EP_2_LEN) == SIM_ACK) {
+				sent++;
+				continue;
+			}
+		}
+		bulk_receive(out, received++);
+	}
+	settle();
+}
+
+static void report(const struct phase *p)
+{
+	printf("%-12s %9lu %10lu %10lu %9.1f %9.1f",
+	       p->name, p->transfers, p->busy_calls, p->idle_calls,
+	       p->busy_calls? (double) p->busy_ns / p->busy_calls: 0.0,
+	       p->idle_calls? (double) p->idle_ns / p->idle_calls: 0.0);
+	if (perf_fd >= 0)
+		printf(" %9.1f %9.1f",
+		       p->busy_calls? (double) p->busy_insns / p->busy_calls: 0.0,
+		       p->idle_calls? (double) p->idle_insns / p->idle_calls: 0.0);
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static struct phase enumeration = { "enumeration" };
+	static struct phase control_phase = { "control" };
+	static struct phase bulk = { "bulk" };
+	int iterations = argc > 1? atoi(argv[1]): 1000;
+	int i;
+
+	open_perf();
+	calibrate();
+
+	phase = &enumeration;
+	usb_init();
+	for (i = 0; i < iterations; i++)
+		enumerate();
+
+	phase = &control_phase;
+	for (i = 0; i < iterations; i++)
+		control_requests();
+
+	phase = &bulk;
+	bulk_loopback(iterations * 10);
+
+	printf("%-12s %9s %10s %10s %9s %9s", "phase", "transfers",
+	       "busy calls", "idle calls", "ns/busy", "ns/idle");
+	if (perf_fd >= 0)
+		printf(" %9s %9s", "ins/busy", "ins/idle");
+	printf("\n");
+	report(&enumeration);
+	report(&control_phase);
+	report(&bulk);
+
+	printf("\nsim: %lu transactions, %lu NAKs, %lu STALLs, %lu timeouts, "
+	       "%lu toggle errors, %lu overruns\n",
+	       sim_stats.transactions, sim_stats.naks, sim_stats.stalls,
+	       sim_stats.timeouts, sim_stats.toggle_errors, sim_stats.overruns);
+	if (perf_fd < 0)
+		printf("(perf events unavailable, instruction counts not shown)\n");
+
+	return sim_stats.toggle_errors || sim_stats.overruns;
+}
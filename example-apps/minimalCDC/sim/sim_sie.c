@@ -0,0 +1,351 @@
+/*
+    simulated PIC16F1454 USB SIE for host builds of M-Stack (USB_HOST_SIM)
+
+    The stack's buffer descriptor table and endpoint buffers are placed in
+    the sim_bdt and sim_usbram sections by usb_hal.h; the linker provides
+    __start_/__stop_ symbols for both, which is how the SIE finds them, just
+    as the real one finds them at 0x2000 and 0x2080.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xc.h"
+#include "sim_sie.h"
+
+/* linear address of the first byte of USB RAM after the BDT */
+#define SIM_BUFFER_ADDR 0x2080
+
+#define BDNSTAT_UOWN   0x80
+#define BDNSTAT_DTS    0x40
+#define BDNSTAT_DTSEN  0x08
+#define BDNSTAT_BSTALL 0x04
+
+#define PID_OUT   0x1
+#define PID_IN    0x9
+#define PID_SETUP 0xD
+
+#define USTAT_FIFO_DEPTH 4
+
+volatile uint8_t UIR, UIE, UEIE, UCON, UCFG, USTAT, UADDR;
+volatile uint8_t PIR2, PIE2;
+volatile uint8_t UEP[16];
+
+struct sim_stats sim_stats;
+
+extern uint8_t __start_sim_bdt[], __stop_sim_bdt[];
+extern uint8_t __start_sim_usbram[], __stop_sim_usbram[];
+
+static uint8_t ustat_fifo[USTAT_FIFO_DEPTH];
+static int fifo_head, fifo_count;
+
+static uint8_t ppbi[16][2];		/* SIE ping-pong pointers, [ep][dir] */
+static uint8_t host_toggle[16][2];	/* DATA0/1 the host will send/expect next */
+static uint8_t host_address;
+
+static void sim_abort(const char *what, unsigned value)
+{
+	fprintf(stderr, "sim: %s (0x%04x)\n", what, value);
+	abort();
+}
+
+uint16_t sim_phys_addr(void *ptr)
+{
+	return SIM_BUFFER_ADDR + ((uint8_t *) ptr - __start_sim_usbram);
+}
+
+static void update_usbif(void)
+{
+	if (UIR & UIE)
+		PIR2bits.USBIF = 1;
+}
+
+/* put the head of the USTAT FIFO in USTAT, if the CPU has taken the last one */
+static void present_ustat(void)
+{
+	if (fifo_count && !UIRbits.TRNIF) {
+		USTAT = ustat_fifo[fifo_head];
+		UIRbits.TRNIF = 1;
+		update_usbif();
+	}
+}
+
+static void pop_ustat(void)
+{
+	if (fifo_count) {
+		fifo_head = (fifo_head + 1) % USTAT_FIFO_DEPTH;
+		fifo_count--;
+	}
+}
+
+void sim_clear_token_if(void)
+{
+	if (UIRbits.TRNIF) {
+		UIRbits.TRNIF = 0;
+		pop_ustat();
+	}
+	present_ustat();
+}
+
+void sim_clear_all_if(void)
+{
+	if (UIRbits.TRNIF)
+		pop_ustat();
+	UIR = 0;
+	present_ustat();
+}
+
+volatile UCONbits_t *sim_ping_pong_reset(void)
+{
+	memset(ppbi, 0, sizeof(ppbi));
+	return &UCONbits;
+}
+
+static int ping_pong(uint8_t ep, uint8_t dir)
+{
+	switch (UCFG & 3) {
+	case 1: /* PPB_EPO_OUT_ONLY */
+		return ep == 0 && dir == 0;
+	case 2: /* PPB_ALL */
+		return 1;
+	case 3: /* PPB_EPN_ONLY */
+		return ep != 0;
+	}
+	return 0;
+}
+
+/* BDT index per the PIC16F1454 datasheet, table 26-3 */
+static int bd_index(uint8_t ep, uint8_t dir)
+{
+	uint8_t oe = ppbi[ep][dir];
+
+	switch (UCFG & 3) {
+	case 1: /* PPB_EPO_OUT_ONLY */
+		if (ep == 0)
+			return dir? 2: oe;
+		return ep * 2 + 1 + dir;
+	case 2: /* PPB_ALL */
+		return ep * 4 + dir * 2 + oe;
+	case 3: /* PPB_EPN_ONLY */
+		if (ep == 0)
+			return dir;
+		return ep * 4 - 2 + dir * 2 + oe;
+	}
+	return ep * 2 + dir;
+}
+
+static uint8_t *bd(uint8_t ep, uint8_t dir)
+{
+	int index = bd_index(ep, dir);
+
+	if ((size_t) (index + 1) * 4 > (size_t) (__stop_sim_bdt - __start_sim_bdt))
+		sim_abort("token for a BD outside the BDT", index);
+	return __start_sim_bdt + index * 4;
+}
+
+static size_t bd_count(const uint8_t *b)
+{
+	return (b[0] & 0x03) << 8 | b[1];
+}
+
+static uint8_t *bd_buffer(const uint8_t *b, size_t len)
+{
+	unsigned adr = b[2] | b[3] << 8;
+	size_t ram = __stop_sim_usbram - __start_sim_usbram;
+
+	if (adr < SIM_BUFFER_ADDR || adr - SIM_BUFFER_ADDR + len > ram)
+		sim_abort("BD points outside USB RAM", adr);
+	return __start_sim_usbram + (adr - SIM_BUFFER_ADDR);
+}
+
+/* hand the BD back to the CPU and queue the USTAT entry for it */
+static void complete(uint8_t *b, uint8_t pid, uint8_t toggle, size_t len,
+                     uint8_t ep, uint8_t dir)
+{
+	b[1] = len & 0xff;
+	b[0] = pid << 2 | (toggle? BDNSTAT_DTS: 0) | (len >> 8 & 0x03);
+
+	ustat_fifo[(fifo_head + fifo_count) % USTAT_FIFO_DEPTH] =
+		ep << 3 | dir << 2 | ppbi[ep][dir] << 1;
+	fifo_count++;
+	sim_stats.transactions++;
+
+	if (ping_pong(ep, dir))
+		ppbi[ep][dir] ^= 1;
+	present_ustat();
+}
+
+/* checks common to every token, before a BD is looked at */
+static int addressed(uint8_t ep, uint8_t dir)
+{
+	UEP1bits_t uep;
+
+	if (!UCONbits.USBEN || UADDR != host_address || ep > 7) {
+		sim_stats.timeouts++;
+		return SIM_TIMEOUT;
+	}
+	uep.reg = UEP[ep];
+	if (!(dir? uep.EPINEN: uep.EPOUTEN)) {
+		sim_stats.timeouts++;
+		return SIM_TIMEOUT;
+	}
+	if (fifo_count == USTAT_FIFO_DEPTH) {
+		sim_stats.naks++;
+		return SIM_NAK;
+	}
+	return SIM_ACK;
+}
+
+static int stalled(uint8_t ep, const uint8_t *b)
+{
+	if ((b[0] & BDNSTAT_BSTALL) || (UEP[ep] & 0x01 /*EPSTALL*/)) {
+		UIRbits.STALLIF = 1;
+		update_usbif();
+		sim_stats.stalls++;
+		return 1;
+	}
+	return 0;
+}
+
+void sim_bus_reset(void)
+{
+	fifo_head = fifo_count = 0;
+	memset(ppbi, 0, sizeof(ppbi));
+	memset(host_toggle, 0, sizeof(host_toggle));
+	host_address = 0;
+	UIRbits.TRNIF = 0;
+	UIRbits.URSTIF = 1;
+	update_usbif();
+}
+
+void sim_start_of_frame(void)
+{
+	UIRbits.SOFIF = 1;
+	update_usbif();
+}
+
+void sim_set_address(uint8_t address)
+{
+	host_address = address;
+}
+
+void sim_reset_toggles(uint8_t ep)
+{
+	host_toggle[ep][0] = host_toggle[ep][1] = 0;
+}
+
+int sim_setup(const void *packet)
+{
+	uint8_t *b;
+	int r;
+
+	r = addressed(0, 0);
+	if (r != SIM_ACK)
+		return r;
+
+	/* A SETUP is never stalled; it replaces whatever was in the BD. */
+	b = bd(0, 0);
+	if (!(b[0] & BDNSTAT_UOWN)) {
+		sim_stats.naks++;
+		return SIM_NAK;
+	}
+	if (bd_count(b) < 8) {
+		sim_stats.overruns++;
+		return SIM_ACK;
+	}
+
+	memcpy(bd_buffer(b, 8), packet, 8);
+	UCONbits.PKTDIS = 1;
+	complete(b, PID_SETUP, 0, 8, 0, 0);
+
+	host_toggle[0][0] = host_toggle[0][1] = 1;
+	return SIM_ACK;
+}
+
+int sim_out(uint8_t ep, const void *data, size_t len)
+{
+	uint8_t *b;
+	int r;
+
+	r = addressed(ep, 0);
+	if (r != SIM_ACK)
+		return r;
+	if (ep == 0 && UCONbits.PKTDIS) {
+		sim_stats.naks++;
+		return SIM_NAK;
+	}
+
+	b = bd(ep, 0);
+	if (!(b[0] & BDNSTAT_UOWN)) {
+		sim_stats.naks++;
+		return SIM_NAK;
+	}
+	if (stalled(ep, b))
+		return SIM_STALL;
+
+	if ((b[0] & BDNSTAT_DTSEN) &&
+	    !!(b[0] & BDNSTAT_DTS) != host_toggle[ep][0]) {
+		/* The SIE ACKs and drops a packet with the wrong toggle, taking
+		   it for a retry; the host moves on to the next toggle. */
+		sim_stats.toggle_errors++;
+		host_toggle[ep][0] ^= 1;
+		return SIM_ACK;
+	}
+	if (len > bd_count(b)) {
+		sim_stats.overruns++;
+		len = bd_count(b);
+	}
+
+	if (len)
+		memcpy(bd_buffer(b, len), data, len);
+	complete(b, PID_OUT, host_toggle[ep][0], len, ep, 0);
+
+	host_toggle[ep][0] ^= 1;
+	return SIM_ACK;
+}
+
+int sim_in(uint8_t ep, void *data, size_t max_len, size_t *len)
+{
+	uint8_t *b;
+	uint8_t toggle;
+	size_t count;
+	int r;
+
+	*len = 0;
+	r = addressed(ep, 1);
+	if (r != SIM_ACK)
+		return r;
+	if (ep == 0 && UCONbits.PKTDIS) {
+		sim_stats.naks++;
+		return SIM_NAK;
+	}
+
+	b = bd(ep, 1);
+	if (!(b[0] & BDNSTAT_UOWN)) {
+		sim_stats.naks++;
+		return SIM_NAK;
+	}
+	if (stalled(ep, b))
+		return SIM_STALL;
+
+	count = bd_count(b);
+	if (count > max_len) {
+		sim_stats.overruns++;
+		count = max_len;
+	}
+	toggle = !!(b[0] & BDNSTAT_DTS);
+
+	if (toggle != host_toggle[ep][1]) {
+		/* The host ACKs and drops it; the device has moved on. */
+		sim_stats.toggle_errors++;
+	}
+	else {
+		if (count)
+			memcpy(data, bd_buffer(b, count), count);
+		*len = count;
+		host_toggle[ep][1] ^= 1;
+	}
+	complete(b, PID_IN, toggle, count, ep, 1);
+	return SIM_ACK;
+}
@@ -0,0 +1,50 @@
+/*
+    simulated PIC16F1454 USB SIE for host builds of M-Stack (USB_HOST_SIM)
+
+    The functions below are the bus side: each one is a single token as the
+    host controller would issue it, and is answered from the buffer
+    descriptor table exactly as the SIE would (UOWN, BSTALL, DTSEN/DTS,
+    ping-pong pointers, the 4-deep USTAT FIFO).  Nothing here calls into
+    the stack; the caller runs usb_service() between tokens.
+*/
+
+#ifndef SIM_SIE_H__
+#define SIM_SIE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* handshake seen by the host for a token */
+enum sim_handshake {
+	SIM_ACK,
+	SIM_NAK,
+	SIM_STALL,
+	SIM_TIMEOUT,	/* no response: wrong address, endpoint disabled, USB off */
+};
+
+struct sim_stats {
+	unsigned long transactions;	/* tokens completed into the USTAT FIFO */
+	unsigned long naks;
+	unsigned long stalls;
+	unsigned long timeouts;
+	unsigned long toggle_errors;	/* DATA0/1 mismatches, either direction */
+	unsigned long overruns;		/* packet longer than the BD allowed */
+};
+
+extern struct sim_stats sim_stats;
+
+/* drive SE0: raises URSTIF, flushes the USTAT FIFO, address goes to 0 */
+void sim_bus_reset(void);
+/* raises SOFIF */
+void sim_start_of_frame(void);
+
+/* address the host puts in tokens, after a SET_ADDRESS has completed */
+void sim_set_address(uint8_t address);
+/* host-side data toggles back to DATA0 (SET_CONFIGURATION, CLEAR_FEATURE) */
+void sim_reset_toggles(uint8_t ep);
+
+int sim_setup(const void *packet);	/* 8 bytes to EP0 */
+int sim_out(uint8_t ep, const void *data, size_t len);
+int sim_in(uint8_t ep, void *data, size_t max_len, size_t *len);
+
+#endif /* SIM_SIE_H__ */
@@ -0,0 +1,136 @@
+/*
+    stand-in for the XC8 <xc.h> when M-Stack is built on the host with
+    USB_HOST_SIM; the PIC16F1454 USB SFRs are ordinary variables owned by
+    the simulated SIE in sim_sie.c
+*/
+
+#ifndef SIM_XC_H__
+#define SIM_XC_H__
+
+#include <stdint.h>
+
+typedef union {
+	struct {
+		uint8_t URSTIF : 1;
+		uint8_t UERRIF : 1;
+		uint8_t ACTVIF : 1;
+		uint8_t TRNIF : 1;
+		uint8_t IDLEIF : 1;
+		uint8_t STALLIF : 1;
+		uint8_t SOFIF : 1;
+		uint8_t : 1;
+	};
+	uint8_t reg;
+} UIRbits_t;
+
+typedef union {
+	struct {
+		uint8_t URSTIE : 1;
+		uint8_t UERRIE : 1;
+		uint8_t ACTVIE : 1;
+		uint8_t TRNIE : 1;
+		uint8_t IDLEIE : 1;
+		uint8_t STALLIE : 1;
+		uint8_t SOFIE : 1;
+		uint8_t : 1;
+	};
+	uint8_t reg;
+} UIEbits_t;
+
+typedef union {
+	struct {
+		uint8_t : 1;
+		uint8_t SUSPND : 1;
+		uint8_t RESUME : 1;
+		uint8_t USBEN : 1;
+		uint8_t PKTDIS : 1;
+		uint8_t SE0 : 1;
+		uint8_t PPBRST : 1;
+		uint8_t : 1;
+	};
+	uint8_t reg;
+} UCONbits_t;
+
+typedef union {
+	struct {
+		uint8_t PPB0 : 1;
+		uint8_t PPB1 : 1;
+		uint8_t FSEN : 1;
+		uint8_t : 1;
+		uint8_t UPUEN : 1;
+		uint8_t : 2;
+		uint8_t UTEYE : 1;
+	};
+	uint8_t reg;
+} UCFGbits_t;
+
+typedef union {
+	struct {
+		uint8_t : 1;
+		uint8_t PPBI : 1;
+		uint8_t DIR : 1;
+		uint8_t ENDP : 4;
+		uint8_t : 1;
+	};
+	uint8_t reg;
+} USTATbits_t;
+
+typedef union {
+	struct {
+		uint8_t EPSTALL : 1;
+		uint8_t EPINEN : 1;
+		uint8_t EPOUTEN : 1;
+		uint8_t EPCONDIS : 1;
+		uint8_t EPHSHK : 1;
+		uint8_t : 3;
+	};
+	uint8_t reg;
+} UEP1bits_t;
+
+typedef union {
+	struct {
+		uint8_t : 2;
+		uint8_t USBIF : 1;
+		uint8_t : 5;
+	};
+	uint8_t reg;
+} PIR2bits_t;
+
+typedef union {
+	struct {
+		uint8_t : 2;
+		uint8_t USBIE : 1;
+		uint8_t : 5;
+	};
+	uint8_t reg;
+} PIE2bits_t;
+
+extern volatile uint8_t UIR, UIE, UEIE, UCON, UCFG, USTAT, UADDR;
+extern volatile uint8_t PIR2, PIE2;
+/* UEP0-UEP7; usb_init() clears 16 of them, so the rest is padding */
+extern volatile uint8_t UEP[16];
+
+#define UIRbits   (*(volatile UIRbits_t *) &UIR)
+#define UIEbits   (*(volatile UIEbits_t *) &UIE)
+#define UCONbits  (*(volatile UCONbits_t *) &UCON)
+#define UCFGbits  (*(volatile UCFGbits_t *) &UCFG)
+#define USTATbits (*(volatile USTATbits_t *) &USTAT)
+#define PIR2bits  (*(volatile PIR2bits_t *) &PIR2)
+#define PIE2bits  (*(volatile PIE2bits_t *) &PIE2)
+
+#define UEP0 UEP[0]
+#define UEP1 UEP[1]
+#define UEP2 UEP[2]
+#define UEP3 UEP[3]
+#define UEP4 UEP[4]
+#define UEP5 UEP[5]
+#define UEP6 UEP[6]
+#define UEP7 UEP[7]
+
+/* hooks used by the USB_HOST_SIM section of usb_hal.h */
+uint16_t sim_phys_addr(void *ptr);
+void sim_clear_token_if(void);
+void sim_clear_all_if(void);
+volatile UCONbits_t *sim_ping_pong_reset(void);
+
+#endif /* SIM_XC_H__ */
@@ -36,6 +36,8 @@
 #include <delays.h>
 #elif __XC8
 #include <xc.h>
+#elif defined(USB_HOST_SIM)
+#include <xc.h> /* the simulated SFRs, see sim/xc.h */
 #else
 #error "Compiler not supported"
 #endif
@@ -210,6 +212,8 @@ static struct buffer_descriptor bds[NUM_BD] BD_ATTR_TAG;
 	   (so far). */
 #elif __XC8
 	/* Addresses are set by BD_ADDR and BUF_ADDR below. */
+#elif defined(USB_HOST_SIM)
+	/* Placed in the simulated USB RAM by XC8_BUFFER_ADDR_TAG. */
 #else
 	#error compiler not supported
 #endif
@@ -1368,6 +1372,10 @@ static inline void handle_ep0_in()
    and service USB requests */
 void usb_service(void)
 {
+#ifdef USB_MAX_TOKENS_PER_SERVICE
+	uint8_t tokens;
+#endif
+
 	if (SFR_USB_RESET_IF) {
 		/* A Reset was detected on the wire. Re-init the SIE. */
 #ifdef USB_RESET_CALLBACK
@@ -1394,7 +1402,17 @@ void usb_service(void)
 	}
 
 
+#ifdef USB_MAX_TOKENS_PER_SERVICE
+	/* Work through the USTAT FIFO (up to four completed transactions)
+	 * instead of taking one token per call, but no more than the
+	 * configured number so SOF handling stays timely. A bus reset ends
+	 * the loop; it is handled, before anything else, on the next call. */
+	for (tokens = 0; tokens < USB_MAX_TOKENS_PER_SERVICE &&
 #ifdef USB_USE_INTERRUPTS
+	     SFR_TRANSFER_IE &&
+#endif
+	     SFR_USB_TOKEN_IF && !SFR_USB_RESET_IF; tokens++) {
+#elif defined(USB_USE_INTERRUPTS)
 	if (SFR_USB_TOKEN_IF && SFR_TRANSFER_IE) {
 #else
 	if (SFR_USB_TOKEN_IF) {
@@ -1467,6 +1485,12 @@ void usb_service(void)
 		}
 
 		CLEAR_USB_TOKEN_IF();
+#if defined(USB_MAX_TOKENS_PER_SERVICE) && defined(_PIC14E)
+		/* The SIE takes a few instruction cycles after the clear to
+		 * present the next USTAT FIFO entry; without this the loop
+		 * test can miss it. */
+		_delay(6);
+#endif
 	}
 	
 	/* Check for Start-of-Frame interrupt. */
@@ -1552,6 +1576,17 @@ bool usb_in_endpoint_busy(uint8_t endpoint)
 #endif
 }
 
+uint8_t usb_in_endpoint_free_banks(uint8_t endpoint)
+{
+	if (g_configuration == 0 || usb_in_endpoint_halted(endpoint))
+		return 0;
+#ifdef PPB_EPn
+	return !BDSnIN(endpoint,0).STAT.UOWN + !BDSnIN(endpoint,1).STAT.UOWN;
+#else
+	return !BDSnIN(endpoint,0).STAT.UOWN;
+#endif
+}
+
 uint8_t usb_halt_ep_in(uint8_t ep)
 {
 	if (ep == 0 || ep > NUM_ENDPOINT_NUMBERS)
@@ -1595,6 +1630,16 @@ bool usb_out_endpoint_has_data(uint8_t endpoint)
 #endif
 }
 
+uint8_t usb_out_endpoint_pending_banks(uint8_t endpoint)
+{
+	/* Armed and stalled buffers are both owned by the SIE. */
+#ifdef PPB_EPn
+	return !BDSnOUT(endpoint,0).STAT.UOWN + !BDSnOUT(endpoint,1).STAT.UOWN;
+#else
+	return !BDSnOUT(endpoint,0).STAT.UOWN;
+#endif
+}
+
 void usb_arm_out_endpoint(uint8_t endpoint)
 {
 #ifdef PPB_EPn
@@ -1707,6 +1752,8 @@ void __attribute__((vector(_USB_1_VECTOR), interrupt(), nomips16)) _USB1Interrup
 #elif __XC8
 	/* On these systems, interupt handlers are shared. An interrupt
 	 * handler from the application must call usb_service(). */
+#elif defined(USB_HOST_SIM)
+	/* The simulation calls usb_service() itself. */
 #else
 #error Compiler not supported yet
 #endif
@@ -48,6 +48,10 @@
 
 //#define USB_USE_INTERRUPTS
 
+/* Handle up to this many completed transactions per usb_service() call
+   instead of one; the USTAT FIFO holds four. */
+#define USB_MAX_TOKENS_PER_SERVICE 4
+
 /* Objects from usb_descriptors.c */
 #define USB_DEVICE_DESCRIPTOR this_device_descriptor
 #define USB_CONFIG_DESCRIPTOR_MAP usb_application_config_descs
@@ -571,6 +571,123 @@ struct buffer_descriptor {
 #define memcpy_from_rom(x,y,z) memcpy(x,y,z)
 
 
+#elif defined(USB_HOST_SIM)
+
+/* Host build against the simulated SIE in sim/. The register names are the
+ * PIC16F1454 ones (sim/xc.h declares them as plain variables), so this is
+ * the _PIC14E section except for the operations whose side effects the SIE
+ * has to see: those go through sim_*() hooks instead of bare assignments. */
+#define NEEDS_PULL /* Whether to pull up D+/D- with SFR_PULL_EN. */
+#define HAS_LOW_SPEED
+#define NEEDS_CLEAR_STALL
+
+#define BDNADR_TYPE              uint16_t
+#define PHYS_ADDR(VIRTUAL_ADDR)  sim_phys_addr(VIRTUAL_ADDR)
+
+#define SFR_FULL_SPEED_EN        UCFGbits.FSEN
+#define SFR_PULL_EN              UCFGbits.UPUEN
+#define SET_PING_PONG_MODE(n)    do { UCFGbits.PPB0 = n & 1; UCFGbits.PPB1 = (n & 2)? 1: 0; } while (0)
+
+#define SFR_USB_INTERRUPT_FLAGS  UIR
+#define SFR_USB_RESET_IF         UIRbits.URSTIF
+#define SFR_USB_STALL_IF         UIRbits.STALLIF
+#define SFR_USB_TOKEN_IF         UIRbits.TRNIF
+#define SFR_USB_SOF_IF           UIRbits.SOFIF
+#define SFR_USB_IF               PIR2bits.USBIF
+
+#define SFR_USB_INTERRUPT_EN     UIE
+#define SFR_TRANSFER_IE          UIEbits.TRNIE
+#define SFR_STALL_IE             UIEbits.STALLIE
+#define SFR_RESET_IE             UIEbits.URSTIE
+#define SFR_SOF_IE               UIEbits.SOFIE
+#define SFR_USB_IE               PIE2bits.USBIE
+
+#define SFR_USB_EXTENDED_INTERRUPT_EN UEIE
+
+#define SFR_EP_MGMT_TYPE         UEP1bits_t
+#define UEP_REG_STRIDE 1
+#define SFR_EP_MGMT(ep)          ((SFR_EP_MGMT_TYPE*) (&UEP0 + UEP_REG_STRIDE * (ep)))
+#define SFR_EP_MGMT_HANDSHAKE    EPHSHK
+#define SFR_EP_MGMT_STALL        EPSTALL
+#define SFR_EP_MGMT_OUT_EN       EPOUTEN
+#define SFR_EP_MGMT_IN_EN        EPINEN
+#define SFR_EP_MGMT_CON_DIS      EPCONDIS /* disable control transfers */
+
+#define SFR_USB_ADDR             UADDR
+#define SFR_USB_EN               UCONbits.USBEN
+#define SFR_USB_PKT_DIS          UCONbits.PKTDIS
+#define SFR_USB_PING_PONG_RESET  sim_ping_pong_reset()->PPBRST
+
+#define SFR_USB_STATUS           USTAT
+#define SFR_USB_STATUS_EP        USTATbits.ENDP
+#define SFR_USB_STATUS_DIR       USTATbits.DIR
+#define SFR_USB_STATUS_PPBI      USTATbits.PPBI
+
+#define CLEAR_ALL_USB_IF()       sim_clear_all_if()
+#define CLEAR_USB_RESET_IF()     SFR_USB_RESET_IF = 0
+#define CLEAR_USB_STALL_IF()     SFR_USB_STALL_IF = 0
+#define CLEAR_USB_TOKEN_IF()     sim_clear_token_if() /* advances the USTAT FIFO */
+#define CLEAR_USB_SOF_IF()       SFR_USB_SOF_IF = 0
+
+#define BDNSTAT_UOWN   0x80
+#define BDNSTAT_DTS    0x40
+#define BDNSTAT_DTSEN  0x08
+#define BDNSTAT_BSTALL 0x04
+#define BDNCNT_MASK    0x03ff /* 10 bits of BDnCNT in BDnSTAT_CNT */
+
+/* Buffer Descriptor, laid out as on the PIC16F1454 (GCC allocates bitfields
+ * LSB first on little-endian hosts, as XC8 does). */
+struct buffer_descriptor {
+	union {
+		struct {
+			/* When receiving from the SIE. (USB Mode) */
+			uint8_t BC8 : 1;
+			uint8_t BC9 : 1;
+			uint8_t PID : 4; /* See enum PID */
+			uint8_t reserved: 1;
+			uint8_t UOWN : 1;
+		};
+		struct {
+			/* When giving to the SIE (CPU Mode) */
+			uint8_t /*BC8*/ : 1;
+			uint8_t /*BC9*/ : 1;
+			uint8_t BSTALL : 1;
+			uint8_t DTSEN : 1;
+			uint8_t INCDIS : 1;
+			uint8_t KEN : 1;
+			uint8_t DTS : 1;
+			uint8_t /*UOWN*/ : 1;
+		};
+		uint8_t BDnSTAT;
+	} STAT;
+	uint8_t BDnCNT;
+	BDNADR_TYPE BDnADR; /* BDnADRL and BDnADRH; */
+};
+
+#ifdef LARGE_EP
+#define SET_BDN(REG, FLAGS, CNT) do { (REG).BDnCNT = (CNT); \
+           (REG).STAT.BDnSTAT = (FLAGS) | ((CNT) & 0x300) >> 8; } while(0)
+#define BDN_LENGTH(REG) ( ((REG).STAT.BDnSTAT & 0x03) << 8 | (REG).BDnCNT )
+#else
+#define SET_BDN(REG, FLAGS, CNT) do { (REG).BDnCNT = (CNT); \
+                                      (REG).STAT.BDnSTAT = (FLAGS); } while(0)
+#define BDN_LENGTH(REG) (REG.BDnCNT)
+#endif
+
+/* Linear addresses the SIE sees, as on the PIC16F1454 */
+#define BD_ADDR 0x2000
+#define BUFFER_ADDR 0x2080
+
+#define PPB_NONE         0
+#define PPB_EPO_OUT_ONLY 1
+#define PPB_ALL          2
+#define PPB_EPN_ONLY     3
+
+#define memcpy_from_rom(x,y,z) memcpy(x,y,z)
+#define FAR
+#define BD_ATTR_TAG __attribute__((section("sim_bdt")))
+#define XC8_BUFFER_ADDR_TAG __attribute__((section("sim_usbram")))
+
 #else
 	#error "Your architecture is not supported"
 #endif
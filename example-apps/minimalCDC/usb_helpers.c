@@ -41,28 +41,15 @@ void app_in_transaction_complete_callback(uint8_t endpoint)
 
 }
 
-int8_t app_unknown_setup_request_callback(const struct setup_packet *setup)
-{
-	/* To use the CDC device class, have a handler for unknown setup
-	 * requests and call process_cdc_setup_request() (as shown here),
-	 * which will check if the setup request is CDC-related, and will
-	 * call the CDC application callbacks defined in usb_cdc.h. For
-	 * composite devices containing other device classes, make sure
-	 * MULTI_CLASS_DEVICE is defined in usb_config.h and call all
-	 * appropriate device class setup request functions here.
-	 */
-	return process_cdc_setup_request(setup);
-}
+/* app_unknown_setup_request_callback() is in main.c; it handles the bridge's
+   vendor request and passes the rest to process_cdc_setup_request(). */
 
 int16_t app_unknown_get_descriptor_callback(const struct setup_packet *pkt, const void **descriptor)
 {
 	return -1;
 }
 
-void app_start_of_frame_callback(void)
-{
-
-}
+/* app_start_of_frame_callback() is in main.c, where it paces EP2 IN. */
 
 void app_usb_reset_callback(void)
 {
@@ -105,18 +92,8 @@ int8_t app_get_comm_feature_callback(uint8_t interface,
 	return -1;
 }
 
-void app_set_line_coding_callback(uint8_t interface,
-                                    const struct cdc_line_coding *coding)
-{
-
-}
-
-int8_t app_get_line_coding_callback(uint8_t interface,
-                                    struct cdc_line_coding *coding)
-{
-	/* This is where baud rate, data, stop, and parity bits are set. */
-	return -1;
-}
+/* app_set_line_coding_callback() and app_get_line_coding_callback() are in
+   main.c, next to the EUSART they program. */
 
 int8_t app_set_control_line_state_callback(uint8_t interface,
                                            bool dtr, bool dts)
@@ -31,21 +31,23 @@
 #include "usb_config.h"
 #include "usb_ch9.h"
 #include "usb_hid.h"
+#include "sof_timer.h"
+#include "reboot_request.h"
 
 /* 
 since this is a downloaded app, configuration words (e.g. __CONFIG or #pragma config) are not relevant
 */
 
-/* counter incremented by USB SOF (Start Of Frame) to track approximate time between reports */
-static uint8_t tick_count;
+/* timers on the USB SOF (Start Of Frame) wheel; see sof_timer.h */
+#define REPORT_TIMER 0
 
 /* arbitrary mouse movement pattern to play back */
 const int8_t move_table[]=
 {
 	/* 
-	X, Y, (at time 0)
-	X, Y, (at time 1)
-	X, Y, (at time 2)
+	X, Y, (from time 0 to time 1)
+	X, Y, (from time 1 to time 2)
+	X, Y, (from time 2 to time 3)
 	...
 	*/
 	6, -2,
@@ -58,11 +60,26 @@ const int8_t move_table[]=
 	6, 2,
 };
 
+/*
+each move in the table is spread over this many 1ms frames, rather than made in one jump
+a report is made every frame, so the pointer moves at the full 1000Hz rate
+*/
+#define SEGMENT_FRAMES 64
+
+/* position in move_table, and in the current move */
+static uint8_t table_index;
+static uint8_t segment_frame;
+
+/* the part of a pixel each axis has gone in the current move, in 1/SEGMENT_FRAMES of a pixel */
+static uint8_t x_fraction, y_fraction;
+
+/* movement made but not yet reported, if the host hasn't taken a report in a while */
+static int16_t x_pending, y_pending;
+
+static void report_task(void);
+
 int main(void)
 {
-	uint8_t table_index = 0;
-	uint8_t *hid_report_in;
-
 #ifdef USB_USE_INTERRUPTS
 	INTCONbits.PEIE = 1;
 	INTCONbits.GIE = 1;
@@ -70,7 +87,8 @@ int main(void)
 
 	usb_init();
 
-	hid_report_in = usb_get_in_buffer(1);
+	/* the report engine runs once per frame, just after the SOF */
+	sof_timer_start(REPORT_TIMER, report_task, 1, 1);
 
 	for (;;)
 	{
@@ -82,30 +100,77 @@ int main(void)
 		if (!usb_is_configured())
 			continue;
 
-		/* proceed further only if it is possible to send more data */
-		if (usb_in_endpoint_halted(1) || usb_in_endpoint_busy(1))
-			continue;
+		sof_timer_run();
+	}
+}
 
-		/* table_index modulus 16 *AND* make table_index an even number */
-		table_index &= 0xE;
-
-		/* build HID report */
-		hid_report_in[0] = 0;
-		if (tick_count > 63) /* if more than 64 ms has passed since the last report... */
-		{
-			tick_count = 0;
-			hid_report_in[1] = move_table[table_index++];
-			hid_report_in[2] = move_table[table_index++];
-		}
-		else
-		{
-			hid_report_in[1] = 0x00;
-			hid_report_in[2] = 0x00;
-		}
-
-		/* transmit HID report */
-		usb_send_in_buffer(1, 3);
+/*
+the whole pixels of a move of d pixels over SEGMENT_FRAMES frames to make this frame
+fraction carries what is left of a pixel from one frame to the next (Bresenham's line algorithm),
+so that over the move the total is exactly d, spread as evenly as whole pixels allow
+*/
+static int8_t interpolate(int8_t d, uint8_t *fraction)
+{
+	uint16_t sum;
+	uint8_t n = 0;
+
+	sum = *fraction + (uint8_t)((d < 0) ? -d : d);
+	while (sum >= SEGMENT_FRAMES)
+	{
+		sum -= SEGMENT_FRAMES;
+		n++;
 	}
+	*fraction = sum;
+
+	return (d < 0) ? -(int8_t)n : (int8_t)n;
+}
+
+static int8_t clamp(int16_t v)
+{
+	if (v > 127)
+		return 127;
+	if (v < -127)
+		return -127;
+	return v;
+}
+
+static void report_task(void)
+{
+	uint8_t *hid_report_in;
+	int8_t x, y;
+
+	/* start each move half a pixel in, so the pixels fall in the middle of the frames they are rounded to */
+	if (0 == segment_frame)
+		x_fraction = y_fraction = SEGMENT_FRAMES / 2;
+
+	x_pending += interpolate(move_table[table_index], &x_fraction);
+	y_pending += interpolate(move_table[table_index + 1], &y_fraction);
+
+	if (SEGMENT_FRAMES == ++segment_frame)
+	{
+		segment_frame = 0;
+		table_index += 2;
+		if (sizeof(move_table) == table_index)
+			table_index = 0;
+	}
+
+	/* if the last report hasn't gone, the movement waits for the next frame; none of it is lost */
+	if (usb_in_endpoint_halted(1) || usb_in_endpoint_busy(1))
+		return;
+
+	x = clamp(x_pending);
+	y = clamp(y_pending);
+	x_pending -= x;
+	y_pending -= y;
+
+	/* build HID report */
+	hid_report_in = usb_get_in_buffer(1);
+	hid_report_in[0] = 0;
+	hid_report_in[1] = x;
+	hid_report_in[2] = y;
+
+	/* transmit HID report */
+	usb_send_in_buffer(1, 3);
 }
 
 /* Callbacks. These function names are set in usb_config.h. */
@@ -164,7 +229,7 @@ int16_t app_unknown_get_descriptor_callback(const struct setup_packet *pkt, cons
 
 void app_start_of_frame_callback(void)
 {
-	tick_count++;
+	sof_timer_tick();
 }
 
 void app_usb_reset_callback(void)
@@ -207,8 +272,11 @@ int8_t app_set_report_callback(uint8_t interface, uint8_t report_type,
 {
 	/* To handle Set_Report, call usb_start_receive_ep0_data_stage()
 	 * here. See the documentation for HID_SET_REPORT_CALLBACK() in
-	 * usb_hid.h. For this device though, there are no output or
-	 * feature reports. */
+	 * usb_hid.h. The only report the host can set on this device is
+	 * the reboot request, on its own interface. */
+	if (REBOOT_INTERFACE == interface)
+		return reboot_request_set_report(report_type);
+
 	return -1;
 }
 
@@ -0,0 +1,169 @@
+/*
+    timer wheel clocked by the USB SOF (Start Of Frame); see sof_timer.h
+
+    the same file is in each example app that uses it
+*/
+
+#include <stdint.h>
+#include "sof_timer.h"
+
+#if SOF_TIMERS > 8
+#error "SOF_TIMERS can be at most 8 (one bit each in sof_due)"
+#endif
+
+#if (SOF_TIMER_SLOTS & (SOF_TIMER_SLOTS - 1)) != 0
+#error "SOF_TIMER_SLOTS must be a power of 2"
+#endif
+
+/*
+the links below hold a timer number plus one, and slot a slot number plus one, so that 0 is "none"
+and everything starts out empty without having to be initialized
+*/
+#define NONE 0
+
+struct sof_timer
+{
+	void (*fn)(void);
+	uint16_t period;	/* 0 for a one-shot */
+	uint16_t rounds;	/* times the wheel has yet to come round to this slot before the timer is due */
+	uint8_t slot;		/* slot the timer is in, or NONE when it isn't running */
+	uint8_t next;		/* next timer in the same slot, or NONE */
+};
+
+static struct sof_timer timers[SOF_TIMERS];
+
+/* first timer in each slot, or NONE */
+static uint8_t wheel[SOF_TIMER_SLOTS];
+
+/* slot for the frame last moved on to */
+static uint8_t cursor;
+
+/* frames counted by sof_timer_tick() that sof_timer_run() hasn't moved the wheel on for yet */
+static volatile uint8_t sof_pending;
+
+/* one bit per timer that has fallen due and not yet run */
+static uint8_t sof_due;
+
+static uint8_t overruns;
+
+/* put timer id in the slot delay frames on from the cursor */
+static void insert(uint8_t id, uint16_t delay)
+{
+	struct sof_timer *t = &timers[id];
+	uint8_t slot;
+
+	if (!delay)
+		delay = 1;
+	slot = (cursor + delay) & (SOF_TIMER_SLOTS - 1);
+	t->rounds = (delay - 1) / SOF_TIMER_SLOTS;
+	t->slot = slot + 1;
+	t->next = wheel[slot];
+	wheel[slot] = id + 1;
+}
+
+static void unlink(uint8_t id)
+{
+	uint8_t *p;
+
+	if (timers[id].slot == NONE)
+		return;
+
+	for (p = &wheel[timers[id].slot - 1]; *p != NONE; p = &timers[*p - 1].next)
+	{
+		if (*p == id + 1)
+		{
+			*p = timers[id].next;
+			break;
+		}
+	}
+	timers[id].slot = NONE;
+}
+
+void sof_timer_start(uint8_t id, void (*fn)(void), uint16_t delay, uint16_t period)
+{
+	sof_timer_stop(id);
+	timers[id].fn = fn;
+	timers[id].period = period;
+	insert(id, delay);
+}
+
+void sof_timer_stop(uint8_t id)
+{
+	unlink(id);
+	sof_due &= ~(1 << id);
+}
+
+void sof_timer_tick(void)
+{
+	if (0xFF != sof_pending)
+		sof_pending++;
+}
+
+uint8_t sof_timer_overruns(void)
+{
+	uint8_t n = overruns;
+
+	overruns = 0;
+	return n;
+}
+
+/* move the wheel on by one frame, marking what falls due in it */
+static void advance(void)
+{
+	uint8_t link, id;
+
+	cursor = (cursor + 1) & (SOF_TIMER_SLOTS - 1);
+
+	/* take the whole slot, then put back what isn't due yet and reschedule the periodic ones */
+	link = wheel[cursor];
+	wheel[cursor] = NONE;
+
+	while (link != NONE)
+	{
+		id = link - 1;
+		link = timers[id].next;
+		timers[id].slot = NONE;
+
+		if (timers[id].rounds)
+		{
+			timers[id].rounds--;
+			timers[id].slot = cursor + 1;
+			timers[id].next = wheel[cursor];
+			wheel[cursor] = id + 1;
+		}
+		else
+		{
+			if (sof_due & (1 << id))
+			{
+				if (0xFF != overruns)
+					overruns++;
+			}
+			sof_due |= 1 << id;
+
+			if (timers[id].period)
+				insert(id, timers[id].period);
+		}
+	}
+}
+
+void sof_timer_run(void)
+{
+	uint8_t id, n;
+
+	if (sof_pending)
+	{
+		/* a single decrement can't be torn by the SOF interrupt incrementing it */
+		sof_pending--;
+		advance();
+	}
+
+	for (id = 0, n = 0; sof_due && (n < SOF_TIMER_DISPATCH) && (id < SOF_TIMERS); id++)
+	{
+		if (sof_due & (1 << id))
+		{
+			sof_due &= ~(1 << id);
+			n++;
+			timers[id].fn();
+		}
+	}
+}
@@ -29,6 +29,7 @@
 #include "usb.h"
 #include "usb_ch9.h"
 #include "usb_hid.h"
+#include "reboot_request.h"
 
 #ifdef __C18
 #define ROMPTR rom
@@ -42,6 +43,9 @@ struct configuration_1_packet
 	struct interface_descriptor      interface;
 	struct hid_descriptor            hid;
 	struct endpoint_descriptor       ep;
+	struct interface_descriptor      reboot_interface;
+	struct hid_descriptor            reboot_hid;
+	struct endpoint_descriptor       reboot_ep;
 };
 
 
@@ -103,7 +107,7 @@ static const ROMPTR struct configuration_1_packet configuration_1 =
 	sizeof(struct configuration_descriptor),
 	DESC_CONFIGURATION,
 	sizeof(configuration_1), // wTotalLength (length of the whole packet)
-	1, // bNumInterfaces
+	2, // bNumInterfaces
 	1, // bConfigurationValue
 	2, // iConfiguration (index of string descriptor)
 	0b10000000,
@@ -143,6 +147,40 @@ static const ROMPTR struct configuration_1_packet configuration_1 =
 	EP_1_IN_LEN, // wMaxPacketSize
 	1, // bInterval in ms.
 	},
+
+	{
+	// Members from struct interface_descriptor, for the reboot request (see reboot_request.h)
+	sizeof(struct interface_descriptor), // bLength;
+	DESC_INTERFACE,
+	REBOOT_INTERFACE, // InterfaceNumber
+	0x0, // AlternateSetting
+	0x1, // bNumEndpoints (num besides endpoint 0)
+	HID_INTERFACE_CLASS, // bInterfaceClass 3=HID
+	0x00, // bInterfaceSubclass (0=NoBootInterface for HID)
+	0x00, // bInterfaceProtocol
+	0x00, // iInterface (index of string describing interface)
+	},
+
+	{
+	// Members from struct hid_descriptor
+	sizeof(struct hid_descriptor),
+	DESC_HID,
+	0x0101, // bcdHID
+	0x0, // bCountryCode
+	1,   // bNumDescriptors
+	DESC_REPORT, // bDescriptorType2
+	REBOOT_REPORT_DESCRIPTOR_LEN, // wDescriptorLength
+	},
+
+	{
+	// Members of the Endpoint Descriptor (EP2 IN), which is never armed
+	sizeof(struct endpoint_descriptor),
+	DESC_ENDPOINT,
+	0x02 | 0x80, // endpoint #2 0x80=IN
+	EP_INTERRUPT, // bmAttributes
+	EP_2_IN_LEN, // wMaxPacketSize
+	255, // bInterval in ms.
+	},
 };
 
 /* String Descriptors */
@@ -206,9 +244,11 @@ STATIC_SIZE_CHECK_EQUAL(sizeof(USB_DEVICE_DESCRIPTOR), 18);
 /* HID Descriptor Function */
 int16_t usb_application_get_hid_descriptor(uint8_t interface, const void **ptr)
 {
-	/* Only one interface in this demo. The two-step assignment avoids an
-	 * incorrect error in XC8 on PIC16. */
+	/* The two-step assignment avoids an incorrect error in XC8 on PIC16. */
 	const void *p = &configuration_1.hid;
+
+	if (REBOOT_INTERFACE == interface)
+		p = &configuration_1.reboot_hid;
 	*ptr = p;
 	return sizeof(configuration_1.hid);
 }
@@ -216,6 +256,11 @@ int16_t usb_application_get_hid_descriptor(uint8_t interface, const void **ptr)
 /** HID Report Descriptor Function */
 int16_t usb_application_get_hid_report_descriptor(uint8_t interface, const void **ptr)
 {
+	if (REBOOT_INTERFACE == interface) {
+		*ptr = reboot_report_descriptor;
+		return sizeof(reboot_report_descriptor);
+	}
+
 	*ptr = mouse_report_descriptor;
 	return sizeof(mouse_report_descriptor);
 }
@@ -0,0 +1,428 @@
+/*
+    text to keystroke compiler for passfob (Linux, or any host with a C
+    compiler)
+
+    Turns a string into the key_table[] that passfob plays back: each
+    character becomes the usage ID of its key and the modifiers it needs,
+    according to a keyboard layout.  The layout is US unless a layout file
+    is given; one of those lists only the characters that differ from US,
+    a line per character:
+
+      <character> <usage ID> [shift] [altgr] [ctrl]
+
+    where the character is itself (UTF-8), "space", or U+hex, the usage ID
+    is from the Keyboard/Keypad page of the HID Usage Tables, and # starts
+    a comment (so # itself is U+23; uk.layout is an example).
+
+    The keys are then packed the way passfob's next_key_report() does it:
+    held down as they are typed, up to six at a time, and only released when
+    the next key repeats a held one, needs other modifiers, or finds no free
+    slot.  For most text that is a fraction of the one press and one release
+    report per character it would otherwise take; the count of reports, and
+    so of 1ms frames, goes to stderr.
+
+    usage: keycomp [-l layout] [-n keys] [-o file] [text ...]
+
+    The text is the arguments joined by spaces, or stdin if there are none.
+    The output is key_table.h for the firmware.  -n sets how many new keys
+    a report may press, as NEW_KEYS_PER_REPORT in main.c does; keep the two
+    the same for the counts to match.  Both default to 1, as hosts don't
+    all type keys pressed in the same report in the same order.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SHIFT 0x02	/* left shift */
+#define ALTGR 0x40	/* right alt */
+#define CTRL  0x01	/* left control */
+
+#define KEY_SLOTS 6
+
+struct key {
+	uint8_t modifiers;
+	uint8_t usage;
+};
+
+struct mapping {
+	uint32_t ch;
+	struct key key;
+};
+
+static struct mapping *layout;
+static size_t layout_len, layout_size;
+
+/* the characters, and their keys, to type */
+static uint32_t *text;
+static struct key *keys;
+static size_t text_len;
+
+static void set_key(uint32_t ch, uint8_t modifiers, uint8_t usage)
+{
+	size_t i;
+
+	for (i = 0; i < layout_len; i++)
+		if (layout[i].ch == ch)
+			break;
+	if (i == layout_len) {
+		if (layout_len == layout_size) {
+			layout_size = layout_size? layout_size * 2: 128;
+			layout = realloc(layout, layout_size * sizeof(*layout));
+			if (!layout) {
+				perror("keycomp");
+				exit(1);
+			}
+		}
+		layout_len++;
+	}
+	layout[i].ch = ch;
+	layout[i].key.modifiers = modifiers;
+	layout[i].key.usage = usage;
+}
+
+static const struct key *find_key(uint32_t ch)
+{
+	size_t i;
+
+	for (i = 0; i < layout_len; i++)
+		if (layout[i].ch == ch)
+			return &layout[i].key;
+	return NULL;
+}
+
+static void us_layout(void)
+{
+	static const char unshifted[] = "-=[]\\;'`,./";
+	static const char shifted[] = "_+{}|:\"~<>?";
+	static const uint8_t punct_usage[] = {
+		0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38
+	};
+	static const char shifted_digits[] = ")!@#$%^&*(";
+	int i;
+
+	for (i = 0; i < 26; i++) {
+		set_key('a' + i, 0, 0x04 + i);
+		set_key('A' + i, SHIFT, 0x04 + i);
+	}
+	/* 1 to 9 are 0x1e to 0x26, and 0 follows them */
+	for (i = 0; i < 10; i++) {
+		set_key('0' + i, 0, i? 0x1d + i: 0x27);
+		set_key(shifted_digits[i], SHIFT, i? 0x1d + i: 0x27);
+	}
+	for (i = 0; unshifted[i]; i++) {
+		set_key(unshifted[i], 0, punct_usage[i]);
+		set_key(shifted[i], SHIFT, punct_usage[i]);
+	}
+	set_key('\n', 0, 0x28);
+	set_key('\t', 0, 0x2b);
+	set_key(' ', 0, 0x2c);
+}
+
+/* decode one UTF-8 character from *s, advancing it; invalid bytes are taken as Latin-1 */
+static uint32_t utf8_next(const unsigned char **s)
+{
+	const unsigned char *p = *s;
+	uint32_t ch;
+	int more, i;
+
+	if (p[0] < 0x80) {
+		*s = p + 1;
+		return p[0];
+	}
+	if ((p[0] & 0xe0) == 0xc0) {
+		ch = p[0] & 0x1f;
+		more = 1;
+	}
+	else if ((p[0] & 0xf0) == 0xe0) {
+		ch = p[0] & 0x0f;
+		more = 2;
+	}
+	else if ((p[0] & 0xf8) == 0xf0) {
+		ch = p[0] & 0x07;
+		more = 3;
+	}
+	else {
+		*s = p + 1;
+		return p[0];
+	}
+	for (i = 1; i <= more; i++) {
+		if ((p[i] & 0xc0) != 0x80) {
+			*s = p + 1;
+			return p[0];
+		}
+		ch = ch << 6 | (p[i] & 0x3f);
+	}
+	*s = p + 1 + more;
+	return ch;
+}
+
+static void put_char(FILE *f, uint32_t ch)
+{
+	if (ch == '\n')
+		fputs("\\n", f);
+	else if (ch == '\t')
+		fputs("\\t", f);
+	else if (ch == '\\' || ch == '\'')
+		fprintf(f, "\\%c", (int) ch);
+	else if (ch < 0x20 || ch == 0x7f)
+		fprintf(f, "\\x%02x", (unsigned) ch);
+	else if (ch < 0x80)
+		fputc(ch, f);
+	else if (ch < 0x800)
+		fprintf(f, "%c%c", 0xc0 | ch >> 6, 0x80 | (ch & 0x3f));
+	else if (ch < 0x10000)
+		fprintf(f, "%c%c%c", 0xe0 | ch >> 12, 0x80 | (ch >> 6 & 0x3f),
+		        0x80 | (ch & 0x3f));
+	else
+		fprintf(f, "%c%c%c%c", 0xf0 | ch >> 18, 0x80 | (ch >> 12 & 0x3f),
+		        0x80 | (ch >> 6 & 0x3f), 0x80 | (ch & 0x3f));
+}
+
+static void read_layout(const char *path)
+{
+	char line[256], *word, *end;
+	const unsigned char *p;
+	unsigned long usage;
+	uint32_t ch;
+	uint8_t modifiers;
+	int lineno = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		word = strtok(line, " \t\r\n");
+		if (!word || word[0] == '#')
+			continue;
+
+		if (!strcmp(word, "space"))
+			ch = ' ';
+		else if ((word[0] == 'U' || word[0] == 'u') && word[1] == '+')
+			ch = strtoul(word + 2, NULL, 16);
+		else {
+			p = (const unsigned char *) word;
+			ch = utf8_next(&p);
+			if (*p)
+				goto bad;
+		}
+
+		word = strtok(NULL, " \t\r\n");
+		if (!word)
+			goto bad;
+		usage = strtoul(word, &end, 0);
+		if (*end || usage == 0 || usage > 0xff)
+			goto bad;
+
+		modifiers = 0;
+		while ((word = strtok(NULL, " \t\r\n")) && word[0] != '#') {
+			if (!strcmp(word, "shift"))
+				modifiers |= SHIFT;
+			else if (!strcmp(word, "altgr"))
+				modifiers |= ALTGR;
+			else if (!strcmp(word, "ctrl"))
+				modifiers |= CTRL;
+			else
+				goto bad;
+		}
+		set_key(ch, modifiers, usage);
+	}
+	fclose(f);
+	return;
+
+bad:
+	fprintf(stderr, "%s:%d: expected <character> <usage ID> [shift] [altgr] [ctrl]\n",
+	        path, lineno);
+	exit(1);
+}
+
+static void add_text(const char *s)
+{
+	const unsigned char *p = (const unsigned char *) s;
+	size_t size = text_len + strlen(s) + 1;
+
+	text = realloc(text, size * sizeof(*text));
+	if (!text) {
+		perror("keycomp");
+		exit(1);
+	}
+	while (*p)
+		text[text_len++] = utf8_next(&p);
+}
+
+/*
+  the same packing as next_key_report() in main.c: report (8 bytes) is
+  the one last sent, and is replaced by the next; returns 0 once the
+  report releasing the last keys has been made
+*/
+static int next_report(uint8_t *report, int *held, size_t *index, int new_keys)
+{
+	int added = 0, i;
+	const struct key *k;
+
+	while (*index < text_len && added < new_keys && *held < KEY_SLOTS) {
+		k = &keys[*index];
+		if (*held && k->modifiers != report[0])
+			break;
+		for (i = 0; i < *held; i++)
+			if (report[2 + i] == k->usage)
+				break;
+		if (i < *held)
+			break;
+
+		report[0] = k->modifiers;
+		report[2 + (*held)++] = k->usage;
+		(*index)++;
+		added++;
+	}
+	if (added)
+		return 1;
+
+	memset(report, 0, 8);
+	*held = 0;
+	return *index < text_len;
+}
+
+static const char *modifier_name(uint8_t modifiers)
+{
+	static char buf[16];
+
+	switch (modifiers) {
+	case 0:             return "0";
+	case SHIFT:         return "SHIFT";
+	case ALTGR:         return "ALTGR";
+	case SHIFT | ALTGR: return "SHIFT | ALTGR";
+	}
+	snprintf(buf, sizeof(buf), "0x%02x", modifiers);
+	return buf;
+}
+
+static void write_table(FILE *f)
+{
+	size_t i;
+
+	fprintf(f, "/* keys played back by passfob; see main.c, and host/keycomp to generate this from a string */\n");
+	fprintf(f, "const struct key key_table[] =\n{\n");
+	for (i = 0; i < text_len; i++) {
+		fprintf(f, "\t{ %s, 0x%x }, // '", modifier_name(keys[i].modifiers), keys[i].usage);
+		put_char(f, text[i]);
+		fprintf(f, "'\n");
+	}
+	fprintf(f, "};\n");
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: keycomp [-l layout] [-n keys] [-o file] [text ...]\n"
+		"  -l  layout file: changes to the US layout, one character a line\n"
+		"  -n  most new keys pressed in one report, 1 to 6 (default 1)\n"
+		"  -o  output file (default stdout)\n"
+		"  with no text arguments, the text is read from stdin\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *layout_path = NULL, *out_path = NULL;
+	uint8_t report[8] = { 0 };
+	size_t index = 0, i, n, reports = 0, releases = 0;
+	int new_keys = 1, held = 0, more, opt;
+	char *buf = NULL;
+	size_t buf_len = 0;
+	FILE *out = stdout;
+
+	while ((opt = getopt(argc, argv, "l:n:o:")) != -1) {
+		switch (opt) {
+		case 'l': layout_path = optarg; break;
+		case 'n': new_keys = atoi(optarg); break;
+		case 'o': out_path = optarg; break;
+		default: usage();
+		}
+	}
+	if (new_keys < 1 || new_keys > KEY_SLOTS)
+		usage();
+
+	us_layout();
+	if (layout_path)
+		read_layout(layout_path);
+
+	if (optind < argc) {
+		for (i = optind; i < (size_t) argc; i++) {
+			if (i > (size_t) optind)
+				add_text(" ");
+			add_text(argv[i]);
+		}
+	}
+	else {
+		/* all of it at once, so that no UTF-8 character is split */
+		do {
+			buf = realloc(buf, buf_len + 4097);
+			if (!buf) {
+				perror("keycomp");
+				return 1;
+			}
+			n = fread(buf + buf_len, 1, 4096, stdin);
+			buf_len += n;
+		} while (n > 0);
+		buf[buf_len] = 0;
+		add_text(buf);
+		free(buf);
+	}
+	if (!text_len) {
+		fprintf(stderr, "keycomp: no text\n");
+		return 1;
+	}
+
+	keys = malloc(text_len * sizeof(*keys));
+	if (!keys) {
+		perror("keycomp");
+		return 1;
+	}
+	for (i = 0; i < text_len; i++) {
+		const struct key *k = find_key(text[i]);
+
+		if (!k) {
+			fprintf(stderr, "keycomp: character %zu ('", i + 1);
+			put_char(stderr, text[i]);
+			fprintf(stderr, "', U+%04X) is not in the layout\n", (unsigned) text[i]);
+			return 1;
+		}
+		keys[i] = *k;
+	}
+	if (text_len > 0xffff) {
+		fprintf(stderr, "keycomp: %zu keys is more than passfob can index\n", text_len);
+		return 1;
+	}
+
+	do {
+		more = next_report(report, &held, &index, new_keys);
+		reports++;
+		if (!held)
+			releases++;
+	} while (more);
+
+	if (out_path) {
+		out = fopen(out_path, "w");
+		if (!out) {
+			perror(out_path);
+			return 1;
+		}
+	}
+	write_table(out);
+	if (out != stdout && fclose(out)) {
+		perror(out_path);
+		return 1;
+	}
+
+	fprintf(stderr, "%zu keys, %zu reports (%zu of them releases), %zu ms at one report a frame;"
+	        " a press and a release per key would take %zu\n",
+	        text_len, reports, releases, reports, text_len * 2);
+	return 0;
+}
@@ -0,0 +1,8 @@
+/* keys played back by passfob; see main.c, and host/keycomp to generate this from a string */
+const struct key key_table[] =
+{
+	{ 0, 0x4 }, // 'a'
+	{ 0, 0x5 }, // 'b'
+	{ 0, 0x6 }, // 'c'
+	{ 0, 0x7 }, // 'd'
+};
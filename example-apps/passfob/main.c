@@ -31,6 +31,8 @@
 #include "usb_config.h"
 #include "usb_ch9.h"
 #include "usb_hid.h"
+#include "sof_timer.h"
+#include "reboot_request.h"
 
 /* 
 since this is a downloaded app, configuration words (e.g. __CONFIG or #pragma config) are not relevant
@@ -47,35 +49,62 @@ this determines which bit to monitor for the bootloader entry
 */
 #define BOOTLOADER_ENTRY_KEYLOCK_MASK 0x04 /* scroll-lock key */
 
-/* flag set upon USB SOF (Start Of Frame) to track approximate time */
-static uint8_t ms_tick = 0;
+/* timers on the SOF (Start Of Frame) wheel; see sof_timer.h */
+#define BUTTON_TIMER 0
+
+/* the button is watched once per 1ms frame, to decide when key_table is played back */
+static enum
+{
+	COOLDOWN,
+	ARMED,
+	TRANSMITTING,
+} state = COOLDOWN;
+static uint16_t count = MIN_TRIGGER_MS;
+static uint16_t table_index = 0;
+
+static void button_task(void);
 
 /*
 arbitrary key strokes to play back
 you MUST consult Section 10 "Keyboard/Keypad Page (0x07)" of the USB "HID Usage Tables" specification
 in order to look up the "Usage ID" of each key press
+each is given with the modifier bits (byte 0 of the report) it needs, e.g. { SHIFT, 0x4 } for 'A'
+the table is in key_table.h, which host/keycomp can generate from a string and a keyboard layout
 */
-const uint8_t key_table[] =
+#define SHIFT 0x02 /* left shift */
+#define ALTGR 0x40 /* right alt */
+
+struct key
 {
-	0x4, // 'a'
-	0x5, // 'b'
-	0x6, // 'c'
-	0x7, // 'd'
+	uint8_t modifiers;
+	uint8_t usage;
 };
 
+#include "key_table.h"
+
+#define KEY_COUNT (sizeof(key_table) / sizeof(key_table[0]))
+
+/*
+the report descriptor has six key slots, so keys are held down as they are typed and only released
+when the next one repeats a held key, needs different modifiers, or there is no slot left for it
+this sets how many of them may be pressed in the same report; the order a host types keys pressed in the
+same report in isn't guaranteed, so the default of 1 (each report adding one key to those already held) is
+the one that is right on every host, and still needs no releases in between
+up to 6 packs the text tighter, for hosts known to take new keys in slot order
+*/
+#define NEW_KEYS_PER_REPORT 1
+
+/* the keyboard report as last sent, and the number of key slots in use */
+static uint8_t key_report[EP_1_IN_LEN];
+static uint8_t keys_held = 0;
+
+static bool next_key_report(void);
+
 static uint16_t keylock_tick_count = 0;
 static uint8_t last_keylock_state = 0;
 
 int main(void)
 {
-	uint8_t table_index = 0;
-	uint16_t count = MIN_TRIGGER_MS;
-	enum
-	{
-		COOLDOWN,
-		ARMED,
-		TRANSMITTING,
-	} state = COOLDOWN;
 	uint8_t *hid_report_in;
 
 	/* enable pull-up on RA3 (for pushbutton detection) */
@@ -88,6 +117,8 @@ int main(void)
 
 	hid_report_in = usb_get_in_buffer(1);
 
+	sof_timer_start(BUTTON_TIMER, button_task, 1, 1);
+
 	for (;;)
 	{
 		usb_service();
@@ -96,31 +127,7 @@ int main(void)
 		if (!usb_is_configured())
 			continue;
 
-		if (ms_tick)
-		{
-			if ( (COOLDOWN == state) || (ARMED == state) )
-			{
-				if (PORTAbits.RA3)
-				{
-					if (count)
-						count--;
-					else
-						state = ARMED;
-				}
-				else
-				{
-					if (count < MIN_TRIGGER_MS)
-						count++;
-					else if (ARMED == state)
-					{
-						state = TRANSMITTING;
-						table_index = 0;
-					}
-				}
-			}
-
-			ms_tick = 0;
-		}
+		sof_timer_run();
 
 		/* proceed further only if it is possible to send more data */
 		if (usb_in_endpoint_halted(1) || usb_in_endpoint_busy(1))
@@ -129,23 +136,9 @@ int main(void)
 		/* build HID report */
 		if (TRANSMITTING == state)
 		{
-			hid_report_in[0] = 0;
-			hid_report_in[1] = 0;
-			if (sizeof(key_table) == table_index)
-			{
+			if (!next_key_report())
 				state = COOLDOWN;
-				hid_report_in[2] = 0x00;
-			}
-			else
-			{
-				hid_report_in[2] = key_table[table_index];
-				table_index++;
-			}
-			hid_report_in[3] = 0;
-			hid_report_in[4] = 0;
-			hid_report_in[5] = 0;
-			hid_report_in[6] = 0;
-			hid_report_in[7] = 0;
+			memcpy(hid_report_in, key_report, EP_1_IN_LEN);
 
 			/* transmit HID report */
 			usb_send_in_buffer(1, EP_1_IN_LEN);
@@ -153,6 +146,71 @@ int main(void)
 	}
 }
 
+static void button_task(void)
+{
+	if ( (COOLDOWN == state) || (ARMED == state) )
+	{
+		if (PORTAbits.RA3)
+		{
+			if (count)
+				count--;
+			else
+				state = ARMED;
+		}
+		else
+		{
+			if (count < MIN_TRIGGER_MS)
+				count++;
+			else if (ARMED == state)
+			{
+				state = TRANSMITTING;
+				table_index = 0;
+			}
+		}
+	}
+}
+
+/*
+move on from key_report to the next report of the key_table playback, starting at key_table[table_index]
+returns false once everything is typed and this is the report releasing the last keys
+*/
+static bool next_key_report(void)
+{
+	uint8_t added = 0, i;
+	const struct key *k;
+
+	while ( (table_index < KEY_COUNT) && (added < NEW_KEYS_PER_REPORT) && (keys_held < 6) )
+	{
+		k = &key_table[table_index];
+
+		/* keys already held are typed with these modifiers, so a change waits for them to be released */
+		if (keys_held && (k->modifiers != key_report[0]))
+			break;
+
+		/* a key that is still down can't be pressed again */
+		for (i = 0; i < keys_held; i++)
+			if (key_report[2 + i] == k->usage)
+				break;
+		if (i < keys_held)
+			break;
+
+		key_report[0] = k->modifiers;
+		key_report[2 + keys_held] = k->usage;
+		keys_held++;
+		table_index++;
+		added++;
+	}
+
+	if (added)
+		return true;
+
+	/* nothing could be pressed on top of what is held, so release it all */
+	memset(key_report, 0, sizeof(key_report));
+	keys_held = 0;
+
+	return (table_index < KEY_COUNT);
+}
+
 /* Callbacks. These function names are set in usb_config.h. */
 void app_set_configuration_callback(uint8_t configuration)
 {
@@ -209,7 +267,7 @@ int16_t app_unknown_get_descriptor_callback(const struct setup_packet *pkt, cons
 
 void app_start_of_frame_callback(void)
 {
-       	ms_tick = 1;
+	sof_timer_tick();
 
 	/* if chosen KEYLOCK is now on, increment keylock_tick_count until it reaches 65535 */
 	if (last_keylock_state & BOOTLOADER_ENTRY_KEYLOCK_MASK)
@@ -251,6 +309,9 @@ static void set_report_callback(bool transfer_ok, void *context)
 int8_t app_set_report_callback(uint8_t interface, uint8_t report_type,
                                uint8_t report_id)
 {
+	if (REBOOT_INTERFACE == interface)
+		return reboot_request_set_report(report_type);
+
 	usb_start_receive_ep0_data_stage(set_report_buf, sizeof(set_report_buf), &set_report_callback, NULL);
 
 	return 0;
@@ -0,0 +1,34 @@
+/*
+    reboot into the bootloader when the host asks, so that new code can be downloaded without unplugging the device
+
+    the same file is in each HID example app
+*/
+
+#ifndef REBOOT_REQUEST_H__
+#define REBOOT_REQUEST_H__
+
+#include <stdint.h>
+#include "usb_config.h"
+
+/*
+the host asks with a one-byte Feature report (no report ID) holding REBOOT_REQUEST, sent to the collection on the
+vendor page (0xFF00); the download tool looks for that collection among the apps it knows
+
+the watchdog is then left to reset the device, and the bootloader stays put after a watchdog reset
+
+a keyboard or mouse can't carry the report in its own collection, since Windows opens those for itself alone;
+such an app defines REBOOT_INTERFACE in usb_config.h as the number of an extra HID interface, which has
+reboot_report_descriptor as its report descriptor and an interrupt IN endpoint that is never armed
+*/
+#define REBOOT_REQUEST 0xB0
+
+#ifdef REBOOT_INTERFACE
+#define REBOOT_REPORT_DESCRIPTOR_LEN 21
+
+extern const uint8_t reboot_report_descriptor[REBOOT_REPORT_DESCRIPTOR_LEN];
+#endif
+
+/* call from app_set_report_callback() for the collection that carries the report; returns what that should */
+int8_t reboot_request_set_report(uint8_t report_type);
+
+#endif /* REBOOT_REQUEST_H__ */
@@ -1313,6 +1313,10 @@ static inline void handle_ep0_in()
    and service USB requests */
 void usb_service(void)
 {
+#ifdef USB_MAX_TOKENS_PER_SERVICE
+	uint8_t tokens;
+#endif
+
 	if (SFR_USB_RESET_IF) {
 		/* A Reset was detected on the wire. Re-init the SIE. */
 #ifdef USB_RESET_CALLBACK
@@ -1339,7 +1343,16 @@ void usb_service(void)
 	}
 
 
+#ifdef USB_MAX_TOKENS_PER_SERVICE
+	/* Work through the USTAT FIFO (up to four completed transactions)
+	 * instead of taking one token per call, but no more than the
+	 * configured number so SOF handling stays timely. A bus reset ends
+	 * the loop; it is handled, before anything else, on the next call. */
+	for (tokens = 0; tokens < USB_MAX_TOKENS_PER_SERVICE &&
+	     SFR_USB_TOKEN_IF && !SFR_USB_RESET_IF; tokens++) {
+#else
 	if (SFR_USB_TOKEN_IF) {
+#endif
 
 		//struct ustat_bits ustat = *((struct ustat_bits*)&USTAT);
 
@@ -1408,6 +1421,12 @@ void usb_service(void)
 		}
 
 		CLEAR_USB_TOKEN_IF();
+#if defined(USB_MAX_TOKENS_PER_SERVICE) && defined(_PIC14E)
+		/* The SIE takes a few instruction cycles after the clear to
+		 * present the next USTAT FIFO entry; without this the loop
+		 * test can miss it. */
+		_delay(6);
+#endif
 	}
 	
 	/* Check for Start-of-Frame interrupt. */
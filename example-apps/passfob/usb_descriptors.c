@@ -1 +1 @@
-/*    example HID keyboard using PIC16F1454 microcontroller    originally written for Microchip USB Framework (aka MLA), but    now based on M-Stack by Alan Ott, Signal 11 Software    Copyright (C) 2014,2015 Peter Lawrence    Permission is hereby granted, free of charge, to any person obtaining a     copy of this software and associated documentation files (the "Software"),     to deal in the Software without restriction, including without limitation     the rights to use, copy, modify, merge, publish, distribute, sublicense,     and/or sell copies of the Software, and to permit persons to whom the     Software is furnished to do so, subject to the following conditions:    The above copyright notice and this permission notice shall be included in     all copies or substantial portions of the Software.    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR     IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL     THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER     LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING     FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER     DEALINGS IN THE SOFTWARE.*/#include "usb_config.h"#include "usb.h"#include "usb_ch9.h"#include "usb_hid.h"#ifdef __C18#define ROMPTR rom#else#define ROMPTR#endifstruct configuration_1_packet{	struct configuration_descriptor  config;	struct interface_descriptor      interface;	struct hid_descriptor            hid;	struct endpoint_descriptor       ep;};/* Device Descriptor */const ROMPTR struct device_descriptor this_device_descriptor ={	sizeof(struct device_descriptor), // bLength	DESC_DEVICE, // bDescriptorType	0x0111, // 0x0200 = USB 2.0, 0x0110 = USB 1.1	0x00, // Device class	0x00, // Device Subclass	0x00, // Protocol.	EP_0_LEN, // bMaxPacketSize0	0x04D8, // Vendor	0x0055, // Product	0x0001, // device release (1.0)	0, // Manufacturer	1, // Product	0, // Serial	NUMBER_OF_CONFIGURATIONS // NumConfigurations};/* HID Report descriptor */static const ROMPTR uint8_t keyboard_report_descriptor[] ={        0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)        0x09, 0x06,                    // USAGE (Keyboard)        0xa1, 0x01,                    // COLLECTION (Application)        0x05, 0x07,                    //   USAGE_PAGE (Keyboard)        0x19, 0xe0,                    //   USAGE_MINIMUM (Keyboard LeftControl)        0x29, 0xe7,                    //   USAGE_MAXIMUM (Keyboard Right GUI)        0x15, 0x00,                    //   LOGICAL_MINIMUM (0)        0x25, 0x01,                    //   LOGICAL_MAXIMUM (1)        0x75, 0x01,                    //   REPORT_SIZE (1)        0x95, 0x08,                    //   REPORT_COUNT (8)        0x81, 0x02,                    //   INPUT (Data,Var,Abs)        0x95, 0x01,                    //   REPORT_COUNT (1)        0x75, 0x08,                    //   REPORT_SIZE (8)        0x81, 0x01,                    //   INPUT (Cnst,Var,Abs)        0x95, 0x03,                    //   REPORT_COUNT (3)        0x75, 0x01,                    //   REPORT_SIZE (1)        0x05, 0x08,                    //   USAGE_PAGE (LEDs)        0x19, 0x01,                    //   USAGE_MINIMUM (Num Lock)        0x29, 0x03,                    //   USAGE_MAXIMUM (Scroll Lock)        0x91, 0x02,                    //   OUTPUT (Data,Var,Abs)        0x95, 0x01,                    //   REPORT_COUNT (1)        0x75, 0x05,                    //   REPORT_SIZE (5)        0x91, 0x01,                    //   OUTPUT (Cnst,Var,Abs)        0x95, 0x06,                    //   REPORT_COUNT (6)        0x75, 0x08,                    //   REPORT_SIZE (8)        0x15, 0x00,                    //   LOGICAL_MINIMUM (0)	0x26, 0xFF, 0x00,              //   LOGICAL_MAXIMUM (255)	0x05, 0x07,                    //   USAGE_PAGE (Keyboard)	0x19, 0x00,                    //   USAGE_MINIMUM (Reserved (no event indicated))	0x2A, 0xFF, 0x00,              //   USAGE_MAXIMUM  (255)	0x81, 0x00,                    //   INPUT (Data,Ary,Abs)	0xC0};/* Configuration 1 Descriptor */static const ROMPTR struct configuration_1_packet configuration_1 ={	{	// Members from struct configuration_descriptor	sizeof(struct configuration_descriptor),	DESC_CONFIGURATION,	sizeof(configuration_1), // wTotalLength (length of the whole packet)	1, // bNumInterfaces	1, // bConfigurationValue	1, // iConfiguration (index of string descriptor)	0b10000000,	100/2,   // 100mA	},	{	// Members from struct interface_descriptor	sizeof(struct interface_descriptor), // bLength;	DESC_INTERFACE,	0x0, // InterfaceNumber	0x0, // AlternateSetting	0x1, // bNumEndpoints (num besides endpoint 0)	HID_INTERFACE_CLASS, // bInterfaceClass 3=HID	0x01, // bInterfaceSubclass (BootInterface for HID)	0x01, // bInterfaceProtocol (keyboard)	0x00, // iInterface (index of string describing interface)	},	{	// Members from struct hid_descriptor	sizeof(struct hid_descriptor),	DESC_HID,	0x0110, // bcdHID	0x0, // bCountryCode	1,   // bNumDescriptors	DESC_REPORT, // bDescriptorType2	sizeof(keyboard_report_descriptor), // wDescriptorLength	},	{	// Members of the Endpoint Descriptor (EP1 IN)	sizeof(struct endpoint_descriptor),	DESC_ENDPOINT,	0x01 | 0x80, // endpoint #1 0x80=IN	EP_INTERRUPT, // bmAttributes	EP_1_IN_LEN, // wMaxPacketSize	1, // bInterval in ms.	},};/* String Descriptors *//* String index 0, only has one character in it, which is to be set to the   language ID of the language which the other strings are in. */static const ROMPTR struct {uint8_t bLength;uint8_t bDescriptorType; uint16_t lang; } str00 = {	sizeof(str00),	DESC_STRING,	0x0409 // US English};static const ROMPTR struct {uint8_t bLength;uint8_t bDescriptorType; uint16_t chars[8]; } product_string = {	sizeof(product_string),	DESC_STRING,	{'k','e','y','b','o','a','r','d'}};/* Get String function * * This function is called by the USB stack to get a pointer to a string * descriptor.  If using strings, USB_STRING_DESCRIPTOR_FUNC must be defined * to the name of this function in usb_config.h.  See * USB_STRING_DESCRIPTOR_FUNC in usb.h for information about this function. * This is a function, and not simply a list or map, because it is useful, * and advisable, to have a serial number string which may be read from * EEPROM or somewhere that's not part of static program memory. */int16_t usb_application_get_string(uint8_t string_number, const void **ptr){	if (string_number == 0) {		*ptr = &str00;		return sizeof(str00);	}	else if (string_number == 1) {		*ptr = &product_string;		return sizeof(product_string);	}	return -1;}/* Configuration Descriptor List */const struct configuration_descriptor *usb_application_config_descs[] ={	(struct configuration_descriptor*) &configuration_1,};STATIC_SIZE_CHECK_EQUAL(USB_ARRAYLEN(USB_CONFIG_DESCRIPTOR_MAP), NUMBER_OF_CONFIGURATIONS);STATIC_SIZE_CHECK_EQUAL(sizeof(USB_DEVICE_DESCRIPTOR), 18);/* HID Descriptor Function */int16_t usb_application_get_hid_descriptor(uint8_t interface, const void **ptr){	/* Only one interface in this demo. The two-step assignment avoids an	 * incorrect error in XC8 on PIC16. */	const void *p = &configuration_1.hid;	*ptr = p;	return sizeof(configuration_1.hid);}/** HID Report Descriptor Function */int16_t usb_application_get_hid_report_descriptor(uint8_t interface, const void **ptr){	*ptr = keyboard_report_descriptor;	return sizeof(keyboard_report_descriptor);}
\ No newline at end of file
+/*    example HID keyboard using PIC16F1454 microcontroller    originally written for Microchip USB Framework (aka MLA), but    now based on M-Stack by Alan Ott, Signal 11 Software    Copyright (C) 2014,2015 Peter Lawrence    Permission is hereby granted, free of charge, to any person obtaining a     copy of this software and associated documentation files (the "Software"),     to deal in the Software without restriction, including without limitation     the rights to use, copy, modify, merge, publish, distribute, sublicense,     and/or sell copies of the Software, and to permit persons to whom the     Software is furnished to do so, subject to the following conditions:    The above copyright notice and this permission notice shall be included in     all copies or substantial portions of the Software.    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR     IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL     THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER     LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING     FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER     DEALINGS IN THE SOFTWARE.*/#include "usb_config.h"#include "usb.h"#include "usb_ch9.h"#include "usb_hid.h"#include "reboot_request.h"#ifdef __C18#define ROMPTR rom#else#define ROMPTR#endifstruct configuration_1_packet{	struct configuration_descriptor  config;	struct interface_descriptor      interface;	struct hid_descriptor            hid;	struct endpoint_descriptor       ep;	struct interface_descriptor      reboot_interface;	struct hid_descriptor            reboot_hid;	struct endpoint_descriptor       reboot_ep;};/* Device Descriptor */const ROMPTR struct device_descriptor this_device_descriptor ={	sizeof(struct device_descriptor), // bLength	DESC_DEVICE, // bDescriptorType	0x0111, // 0x0200 = USB 2.0, 0x0110 = USB 1.1	0x00, // Device class	0x00, // Device Subclass	0x00, // Protocol.	EP_0_LEN, // bMaxPacketSize0	0x04D8, // Vendor	0x0055, // Product	0x0001, // device release (1.0)	0, // Manufacturer	1, // Product	0, // Serial	NUMBER_OF_CONFIGURATIONS // NumConfigurations};/* HID Report descriptor */static const ROMPTR uint8_t keyboard_report_descriptor[] ={        0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)        0x09, 0x06,                    // USAGE (Keyboard)        0xa1, 0x01,                    // COLLECTION (Application)        0x05, 0x07,                    //   USAGE_PAGE (Keyboard)        0x19, 0xe0,                    //   USAGE_MINIMUM (Keyboard LeftControl)        0x29, 0xe7,                    //   USAGE_MAXIMUM (Keyboard Right GUI)        0x15, 0x00,                    //   LOGICAL_MINIMUM (0)        0x25, 0x01,                    //   LOGICAL_MAXIMUM (1)        0x75, 0x01,                    //   REPORT_SIZE (1)        0x95, 0x08,                    //   REPORT_COUNT (8)        0x81, 0x02,                    //   INPUT (Data,Var,Abs)        0x95, 0x01,                    //   REPORT_COUNT (1)        0x75, 0x08,                    //   REPORT_SIZE (8)        0x81, 0x01,                    //   INPUT (Cnst,Var,Abs)        0x95, 0x03,                    //   REPORT_COUNT (3)        0x75, 0x01,                    //   REPORT_SIZE (1)        0x05, 0x08,                    //   USAGE_PAGE (LEDs)        0x19, 0x01,                    //   USAGE_MINIMUM (Num Lock)        0x29, 0x03,                    //   USAGE_MAXIMUM (Scroll Lock)        0x91, 0x02,                    //   OUTPUT (Data,Var,Abs)        0x95, 0x01,                    //   REPORT_COUNT (1)        0x75, 0x05,                    //   REPORT_SIZE (5)        0x91, 0x01,                    //   OUTPUT (Cnst,Var,Abs)        0x95, 0x06,                    //   REPORT_COUNT (6)        0x75, 0x08,                    //   REPORT_SIZE (8)        0x15, 0x00,                    //   LOGICAL_MINIMUM (0)	0x26, 0xFF, 0x00,              //   LOGICAL_MAXIMUM (255)	0x05, 0x07,                    //   USAGE_PAGE (Keyboard)	0x19, 0x00,                    //   USAGE_MINIMUM (Reserved (no event indicated))	0x2A, 0xFF, 0x00,              //   USAGE_MAXIMUM  (255)	0x81, 0x00,                    //   INPUT (Data,Ary,Abs)	0xC0};/* Configuration 1 Descriptor */static const ROMPTR struct configuration_1_packet configuration_1 ={	{	// Members from struct configuration_descriptor	sizeof(struct configuration_descriptor),	DESC_CONFIGURATION,	sizeof(configuration_1), // wTotalLength (length of the whole packet)	2, // bNumInterfaces	1, // bConfigurationValue	1, // iConfiguration (index of string descriptor)	0b10000000,	100/2,   // 100mA	},	{	// Members from struct interface_descriptor	sizeof(struct interface_descriptor), // bLength;	DESC_INTERFACE,	0x0, // InterfaceNumber	0x0, // AlternateSetting	0x1, // bNumEndpoints (num besides endpoint 0)	HID_INTERFACE_CLASS, // bInterfaceClass 3=HID	0x01, // bInterfaceSubclass (BootInterface for HID)	0x01, // bInterfaceProtocol (keyboard)	0x00, // iInterface (index of string describing interface)	},	{	// Members from struct hid_descriptor	sizeof(struct hid_descriptor),	DESC_HID,	0x0110, // bcdHID	0x0, // bCountryCode	1,   // bNumDescriptors	DESC_REPORT, // bDescriptorType2	sizeof(keyboard_report_descriptor), // wDescriptorLength	},	{	// Members of the Endpoint Descriptor (EP1 IN)	sizeof(struct endpoint_descriptor),	DESC_ENDPOINT,	0x01 | 0x80, // endpoint #1 0x80=IN	EP_INTERRUPT, // bmAttributes	EP_1_IN_LEN, // wMaxPacketSize	1, // bInterval in ms.	},	{	// Members from struct interface_descriptor, for the reboot request (see reboot_request.h)	sizeof(struct interface_descriptor), // bLength;	DESC_INTERFACE,	REBOOT_INTERFACE, // InterfaceNumber	0x0, // AlternateSetting	0x1, // bNumEndpoints (num besides endpoint 0)	HID_INTERFACE_CLASS, // bInterfaceClass 3=HID	0x00, // bInterfaceSubclass (0=NoBootInterface for HID)	0x00, // bInterfaceProtocol	0x00, // iInterface (index of string describing interface)	},	{	// Members from struct hid_descriptor	sizeof(struct hid_descriptor),	DESC_HID,	0x0110, // bcdHID	0x0, // bCountryCode	1,   // bNumDescriptors	DESC_REPORT, // bDescriptorType2	REBOOT_REPORT_DESCRIPTOR_LEN, // wDescriptorLength	},	{	// Members of the Endpoint Descriptor (EP2 IN), which is never armed	sizeof(struct endpoint_descriptor),	DESC_ENDPOINT,	0x02 | 0x80, // endpoint #2 0x80=IN	EP_INTERRUPT, // bmAttributes	EP_2_IN_LEN, // wMaxPacketSize	255, // bInterval in ms.	},};/* String Descriptors *//* String index 0, only has one character in it, which is to be set to the   language ID of the language which the other strings are in. */static const ROMPTR struct {uint8_t bLength;uint8_t bDescriptorType; uint16_t lang; } str00 = {	sizeof(str00),	DESC_STRING,	0x0409 // US English};static const ROMPTR struct {uint8_t bLength;uint8_t bDescriptorType; uint16_t chars[8]; } product_string = {	sizeof(product_string),	DESC_STRING,	{'k','e','y','b','o','a','r','d'}};/* Get String function * * This function is called by the USB stack to get a pointer to a string * descriptor.  If using strings, USB_STRING_DESCRIPTOR_FUNC must be defined * to the name of this function in usb_config.h.  See * USB_STRING_DESCRIPTOR_FUNC in usb.h for information about this function. * This is a function, and not simply a list or map, because it is useful, * and advisable, to have a serial number string which may be read from * EEPROM or somewhere that's not part of static program memory. */int16_t usb_application_get_string(uint8_t string_number, const void **ptr){	if (string_number == 0) {		*ptr = &str00;		return sizeof(str00);	}	else if (string_number == 1) {		*ptr = &product_string;		return sizeof(product_string);	}	return -1;}/* Configuration Descriptor List */const struct configuration_descriptor *usb_application_config_descs[] ={	(struct configuration_descriptor*) &configuration_1,};STATIC_SIZE_CHECK_EQUAL(USB_ARRAYLEN(USB_CONFIG_DESCRIPTOR_MAP), NUMBER_OF_CONFIGURATIONS);STATIC_SIZE_CHECK_EQUAL(sizeof(USB_DEVICE_DESCRIPTOR), 18);/* HID Descriptor Function */int16_t usb_application_get_hid_descriptor(uint8_t interface, const void **ptr){	/* The two-step assignment avoids an incorrect error in XC8 on PIC16. */	const void *p = &configuration_1.hid;	if (REBOOT_INTERFACE == interface)		p = &configuration_1.reboot_hid;	*ptr = p;	return sizeof(configuration_1.hid);}/** HID Report Descriptor Function */int16_t usb_application_get_hid_report_descriptor(uint8_t interface, const void **ptr){	if (REBOOT_INTERFACE == interface) {		*ptr = reboot_report_descriptor;		return sizeof(reboot_report_descriptor);	}	*ptr = keyboard_report_descriptor;	return sizeof(keyboard_report_descriptor);}
\ No newline at end of file